@@ -0,0 +1,48 @@
+#!/bin/sh
+# Times a large script read as text, compiled on first use (cold cache)
+# and run from its cached snapshot (warm cache).
+#
+#   bench/script-cache.sh ./smallsh
+#
+# The script is only builtins and comments, so nothing forks and the
+# time is dominated by reading and splitting lines. Each case runs
+# RUNS times and the best wall time is reported.
+
+BENCH_LINES=${BENCH_LINES:-50000}
+RUNS=${RUNS:-5}
+bin=${1:-./smallsh}
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+i=0
+while [ $i -lt "$BENCH_LINES" ]; do
+  echo "# generated step $i: a b c d e f g h i j k l m n o p q r s t u v w x y z"
+  echo "cd / a b c d e f g h i j k l m n o p q r s t u v w x y z $i"
+  i=$((i + 1))
+done > "$dir/script"
+echo exit >> "$dir/script"
+
+best_time() {  # mode: text, cold or warm
+  best=
+  r=0
+  while [ $r -lt "$RUNS" ]; do
+    [ "$1" = cold ] && rm -rf "$dir/cache"
+    flag=
+    [ "$1" = text ] && flag=--no-cache
+    start=$(date +%s%N)
+    XDG_CACHE_HOME="$dir/cache" "$bin" --quiet --norc $flag "$dir/script" > /dev/null
+    end=$(date +%s%N)
+    t=$(( (end - start) / 1000 ))
+    if [ -z "$best" ] || [ $t -lt $best ]; then best=$t; fi
+    r=$((r + 1))
+  done
+  echo $best
+}
+
+base=
+for mode in text cold warm; do
+  t=$(best_time $mode)
+  [ -z "$base" ] && base=$t
+  awk -v m="$mode" -v t="$t" -v base="$base" -v n="$BENCH_LINES" \
+    'BEGIN { printf "%-6s %9.1f ms  %6.3f us/line  x%.3f\n", m, t / 1000, t / (n * 2), base / t }'
+done
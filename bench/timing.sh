@@ -0,0 +1,44 @@
+#!/bin/sh
+# Times smallsh builds on a spawn- and parse-heavy script.
+#
+#   bench/timing.sh ./smallsh ./smallsh-lto ./smallsh-pgo
+#
+# Each binary runs the same generated script RUNS times; the best wall
+# time is reported along with the speedup relative to the first binary.
+
+BENCH_LINES=${BENCH_LINES:-4000}
+RUNS=${RUNS:-5}
+script=$(mktemp)
+trap 'rm -f "$script"' EXIT
+
+i=0
+while [ $i -lt "$BENCH_LINES" ]; do
+  echo "true a b c d e f g h i j k l m n o p q r s t u v w x y z $i"
+  echo "# comment line $i"
+  echo "status"
+  echo "cd /"
+  i=$((i + 1))
+done > "$script"
+echo exit >> "$script"
+
+best_time() {
+  best=
+  r=0
+  while [ $r -lt "$RUNS" ]; do
+    start=$(date +%s%N)
+    "$1" --quiet "$script" > /dev/null
+    end=$(date +%s%N)
+    t=$(( (end - start) / 1000 ))
+    if [ -z "$best" ] || [ $t -lt $best ]; then best=$t; fi
+    r=$((r + 1))
+  done
+  echo $best
+}
+
+base=
+for bin in "$@"; do
+  t=$(best_time "$bin")
+  [ -z "$base" ] && base=$t
+  awk -v b="$bin" -v t="$t" -v base="$base" -v n="$BENCH_LINES" \
+    'BEGIN { printf "%-22s %9.1f ms  %6.2f us/cmd  x%.3f\n", b, t / 1000, t / (n * 4), base / t }'
+done
@@ -1,468 +1,2167 @@
-// --------------------------- Headers --------------------------- //
-
-#include <stdio.h>  // perror, printf
-#include <stdlib.h>
-#include <string.h>  // mem allocation
-#include <fcntl.h>  // open
-#include <unistd.h>  // fork, close, execv, getpid
-#include <sys/types.h>  // pid_t
-#include <sys/wait.h>  // waitpid
-#include <signal.h>  // Signal handlers
-#include "src/shell_info.h"  // shell info struct
-
-// --------------------- Function Prototypes --------------------- //
-void other_cmd(char* args[], struct shell_info *info);
-void custom_SIGINT();
-void custom_IG();
-
-// Global variable declaration for custom Signal Handler
-int stop_background;
-
-// ---------------------- Helper Functions ----------------------- //
-
-// --------------------------------------------------------------- //
-// function   : void print_args(..)
-// parameters : char* args[]
-// description: Prints arguments stored in an array of char pointers
-// --------------------------------------------------------------- //
-void print_args(char* args[]) {
-	int i = 0;
-	while (args[i]) {
-		printf("%s \n", args[i]);
-		i++;
-	}
-}
-
-
-// --------------------------------------------------------------- //
-// function   : free_memory(..)
-// parameters : char* line
-// 						  char* args[]
-// description: Frees dynamically allocated memory in parameters
-// --------------------------------------------------------------- //
-void free_memory(char* line, char* args[]) {
-	free(line);
-	line = NULL;
-
-	int i = 0;
-	while (args[i]) {
-		free(args[i]);   // Free each call to malloc
-		args[i] = NULL;  // Point to NULL
-		i++;
-	}
-}
-
-
-// ------------------- Built-In Shell Functions ------------------ //
-
-// --------------------------------------------------------------- //
-// function   : my_exit()
-// parameters : None
-// description: Ends the shell program when user enters 'exit' cmd
-// --------------------------------------------------------------- //
-int my_exit() {
-	printf("exiting shell \n");
-
-	// flush after every display to stdout to show all output
-	fflush(stdout);
-
-	return 0;  // terminates smallsh by ending do-while loop
-}
-
-
-// --------------------------------------------------------------- //
-// function   : my_cd(..)
-// parameters : char* args []
-// description: Changes directory. If no argument is entered, makes
-//              the current working directory (CWD) to environment
-//              variable HOME. Otherwise, sets CWD to argument
-// example    : cd Documents/Code-Projects/my_c_shell
-// --------------------------------------------------------------- //
-void my_cd(char* args[]) {
-	if (!args[1]) {  // No arguments, set directory to HOME
-		if (chdir(getenv("HOME")) != 0)
-			printf("chdir() failed");  // Display in event of error
-
-	} else {
-		if (chdir(args[1]) != 0)
-			printf("chdir() failed");
-	}
-}
-
-
-// --------------------------------------------------------------- //
-// function   : my_status(..)
-// parameters : int exit_status
-// description: Prints out either the exit status or the terminating
-//              signal of the last foreground process ran by the shell
-//              Decodes status by using termination MACROS
-// --------------------------------------------------------------- //
-void my_status(int exit_status) {
-	if (WIFEXITED(exit_status)) {
-		printf("exit value %d \n", WEXITSTATUS(exit_status));
-		fflush(stdout);
-
-	} else {
-		printf("terminated by signal %d \n", WTERMSIG(exit_status));
-		fflush(stdout);
-	}
-}
-
-
-// ------------------ I/O Redirection Functions ------------------ //
-
-// --------------------------------------------------------------- //
-// function   : output_redirection(..)
-// parameters : char* filename
-// description: Redirects output from stdout to the passed in file
-// reference  : Handling input/output redirection
-//              https://stackoverflow.com/a/11518304/10895933
-// --------------------------------------------------------------- //
-void output_redirection(char* filename) {
-	// Open file and set permissions
-	int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0777);
-
-	if (fd == -1) {  // Error checking
-		perror("Output file could not be opened \n");  // Print error message
-		exit(1);  // Set the exit status to 1
-	}
-
-	int d = dup2(fd, 1);  // Direct output to file descriptor
-
-	if (d == -1) {
-		perror("Output file could not be redirected");
-		exit(1);
-	}
-
-	close(fd);  // Close file
-}
-
-
-// --------------------------------------------------------------- //
-// function   : input_redirection(..)
-// parameters : char* filename
-// description: Redirects input from stdin to the passed in file
-// reference  : Handling input/output redirection
-//              https://stackoverflow.com/a/11518304/10895933
-// --------------------------------------------------------------- //
-void input_redirection(char* filename) {
-	// Open file and set permissions
-	int fd = open(filename, O_RDONLY);
-
-	if (fd == -1) {  // Error checking
-		perror("Input file could not be opened \n");  // Print error message
-		exit(1);  // Set the exit status to 1
-	}
-
-	int d = dup2(fd, 0);  // Direct output to file descriptor
-
-	if (d == -1) {
-		perror("Input file could not be redirected");
-		exit(0);
-	}
-
-	close(fd);  // Close file
-}
-
-
-// -------------------- User Input Functions --------------------- //
-
-// --------------------------------------------------------------- //
-// function   : get_input()
-// parameters : none
-// description: Gets input from user
-//              Allocates memory
-//              Returns pointer to user input
-// references : How to use fgets - http://sekrit.de/webdocs/c/beginners-guide-away-from-scanf.html
-//              remove newline from fgets - https://stackoverflow.com/a/2693826/10895933
-// --------------------------------------------------------------- //
-char* get_input() {
-	char buf[2048];
-	char* line = NULL;
-
-	printf(": ");  // Prompt user
-	fflush(stdout);
-
-	fgets(buf, 2048, stdin);  // Get input from user
-
-	strtok(buf, "\n");  // Remove newline from fgets
-
-	line = malloc(sizeof(char) * sizeof(buf));  // Allocate memory to line
-
-	strcpy(line, buf);  // Store input in line
-
-	return line;  // return user input
-}
-
-
-// --------------------------------------------------------------- //
-// function   : parse_line(..)
-// parameters : char* line
-//              struct shell_info *info
-//              char* args[]
-// description: Splits line param into tokens delimited by whitespace " "
-//              Allocates memory for each token
-//              Stores tokens into args
-// --------------------------------------------------------------- //
-void parse_line(char* line, struct shell_info *info, char* args[]) {
-	char* saveptr;
-	char* token;
-	int i = 0;
-
-	token = strtok_r(line, " ", &saveptr);  // Get first arg into token
-	args[i] = malloc(strlen(token));  // Allocate memory for command
-	strcpy(args[i], token);  // Copy into args
-	i++;  // Argument counter
-
-	while ((token = strtok_r(NULL, " ", &saveptr))) {  // Get rest of arguments
-
-		if (strcmp(token, "<") == 0) {  // Identify any input file
-			info->input_redirect = 1;  // Set input file flag
-			token = strtok_r(NULL, " ", &saveptr);  // Get filename
-			strcpy(info->input_filename, token);  // Save filename
-
-		} else if (strcmp(token, ">") == 0) {  // Repeat for potential outfile
-			info->output_redirect = 1;
-			token = strtok_r(NULL, " ", &saveptr);
-			strcpy(info->output_filename, token);
-
-		} else if (strcmp(token, "&") == 0) {  // Identify background flag
-			info->background = 1;
-
-		} else if (strcmp(token, "$$") == 0) {  // Changes $$ to pid
-			int pid = getpid();
-			args[i] = malloc(6);
-			sprintf(args[i], "%d", pid);
-			i++;
-
-		} else {
-			args[i] = malloc(strlen(token));  // Bloc saves arguments for rest of line
-			strcpy(args[i], token);
-			i++;
-		}
-	}
-}
-
-
-// ------------------ Execute Commands Functions ----------------- //
-
-// --------------------------------------------------------------- //
-// function   : execute_cmd(..)
-// parameters : char* args[]
-//              struct shell_info *info
-// description: Executes command stored in arguments
-//              Follows arguments appropriately
-// --------------------------------------------------------------- //
-int execute_cmd(char* args[], struct shell_info *info) {
-	int cmd;
-	int status = 1;  // Return this to indicate if shell should continue
-
-	// Check for 3 built in functions and comments/blank lines
-	// If not, then execute other command via other_cmd(..)
-	if (strcmp(args[0], "exit") == 0) {  // Exit
-		status = my_exit();
-
-	}	else if (strcmp(args[0], "cd") == 0) {  // Change Directory
-		my_cd(args);
-
-	} else if (strcmp(args[0], "status") == 0) {  // Status
-		my_status(info->exit_status);
-
-	}	else if (strcmp(args[0], "\n") == 0 || args[0][0] == '#') {  // Blank line or comment
-		// Do nothing
-
-	}	else {
-		other_cmd(args, info);  // Execute non-built in commands
-	}
-
-	// Wait for terminated children / clean up zombies
-	int corpse;
-	while ((corpse = waitpid(-1, &info->exit_status, WNOHANG)) > 0) {
-		printf("background pid %d is done: ", corpse);
-		fflush(stdout);
-		my_status(info->exit_status);  // Print how child terminated
-	}
-
-	return status;
-}
-
-
-// --------------------------------------------------------------- //
-// function   : void other_cmd(..)
-// parameters : char* args[]
-//              struct shell_info *info
-// description: This function executes shell commands that aren't
-//              build in. Child processes are spawned and have
-//              different behavior via switch statement to faciliate this
-// --------------------------------------------------------------- //
-void other_cmd (char* args[], struct shell_info *info) {
-	pid_t spawnPid = fork();  // Fork a new process
-
-	struct sigaction SIG_H = { 0 };  // For cusom signal handler
-
-	switch (spawnPid) {
-	case -1:
-		perror("fork() \n");
-		exit(1);
-		break;
-
-	case 0:  // In child process
-
-		custom_IG();  // Children ignore SIGTSTP
-
-		if (info->background && !stop_background) {
-			printf("background pid is %d \n", getpid());  // Display background pid
-			fflush(stdout);
-
-			// Background cmd should use /dev/null for if input | output if respective redirection not specified
-			if (!info->output_redirect)
-				output_redirection("/dev/null");
-
-			if (!info->input_redirect)
-				input_redirection("/dev/null");
-
-		} else {
-			SIG_H.sa_handler = SIG_DFL;  // Restore ^C default functionality in child
-			sigfillset(&SIG_H.sa_mask);  // Only in foreground
-			SIG_H.sa_flags = SA_RESETHAND;
-			sigaction(SIGINT, &SIG_H, NULL);
-		}
-
-		// ------------------ I/O Redirection ------------------ //
-
-		if (info->input_redirect) {
-			input_redirection(info->input_filename);  // Input redirection if applicable
-		}
-
-		if (info->output_redirect) {
-			output_redirection(info->output_filename);  // Output redirection if applicable
-		}
-
-		// ------------------ Execute Command ------------------ //
-
-		execvp(args[0], args);  // Replace the current program with command (aka execute command)
-		perror("execvp");  // this only returns if there is an exec error
-		exit(2);
-		break;
-
-	default:  // In parent process
-
-		if (info->background && !stop_background) {  // Run in background
-			spawnPid = waitpid(spawnPid, &info->exit_status, WNOHANG);
-
-		}	else {  // Run in foreground
-
-			spawnPid = waitpid(spawnPid, &info->exit_status, 0);  // Wait for child's termination
-
-			if (info->exit_status != 0) {  // Print out abnormal exit if applicable
-				my_status(info->exit_status);
-			}
-
-		}
-		break;
-	}
-}
-
-
-// ------------------ Signal Functions ------------------ //
-
-// --------------------------------------------------------------- //
-// function   : handle_SIG(..)
-// parameters : in signo
-// description: Custom handler for SIGINT / ^C
-//              Children running as a foreground process terminates itself
-// reference  : How can a process kill itself - https://stackoverflow.com/a/7851269/10895933
-// --------------------------------------------------------------- //
-void handle_SIG(int signo) {
-	// stop_background is a global variable (only used for custom sig handler)
-	if (stop_background == 0) {
-
-		// Print "No more background" message
-		char* msg = "Entering foreground-only mode (& is now ignored) \n";
-		write(STDOUT_FILENO, msg, 50);
-		fflush(stdout);
-
-		stop_background = 1;  // set stop_background flag on
-
-	}	else {
-		// Print "Background is back on" message
-		char* msg = "Exiting foreground-only mode \n";
-		write(STDOUT_FILENO, msg, 30);
-		fflush(stdout);
-
-		stop_background = 0;  // Set stop_background flag off
-	}
-}
-
-
-void custom_SIG() {
-	struct sigaction SIG_IG = { 0 };  // Ignores ^C
-	SIG_IG.sa_handler = SIG_IGN;	  // This is reinstated for children
-	sigfillset(&SIG_IG.sa_mask);
-	SIG_IG.sa_flags = SA_RESTART;
-	sigaction(SIGINT, &SIG_IG, NULL);
-}
-
-void custom_SIGTSTP() {
-	struct sigaction SIGINT_action = { 0 };  // Init struct to be empty
-	SIGINT_action.sa_handler = handle_SIG;  // Register as the signal handler
-	sigfillset(&SIGINT_action.sa_mask);  // Block all catchable signals while running
-	SIGINT_action.sa_flags = SA_RESTART;  // Clear error caused by signal
-	sigaction(SIGTSTP, &SIGINT_action, NULL);  // Install our signal handler
-}
-
-void custom_IG() {
-	struct sigaction SIG_IG = { 0 };
-	SIG_IG.sa_handler = SIG_IGN;
-	sigfillset(&SIG_IG.sa_mask);
-	SIG_IG.sa_flags = SA_RESTART;
-	sigaction(SIGTSTP, &SIG_IG, NULL);
-}
-
-// ------------------ Shell Main Function ------------------ //
-
-// --------------------------------------------------------------- //
-// function   : small_shell()
-// parameters : none
-// description: Controls the flow of the small shell
-//              Gets user input as string
-//              Parses string into command
-//              Executes command
-//              Loops until user gives exit command
-// --------------------------------------------------------------- //
-void small_shell() {
-	struct shell_info info;
-	int status;
-	char* args[512];
-
-	for (int i = 0; i < 512; i++) {  // Init args to null
-		args[i] = NULL;
-	}
-
-	custom_SIG();  // Set custom signal handlers
-	custom_SIGTSTP();
-
-	printf("smallsh \n");  // Displays title of program
-	fflush(stdout);
-
-	do {
-		init_shell_info(&info);  // Initialize shell info to 0
-
-		char* line = get_input();  // Gets user string input
-
-		parse_line(line, &info, args);  // Parses input into arguments
-
-		status = execute_cmd(args, &info);  // Executes passed in command
-
-		free_memory(line, args);
-
-	} while (status);
-}
-
-
-// ------------------ Main Function ------------------ //
-int main() {
-	small_shell();
-
-	return 0;
-}
+// --------------------------- Headers --------------------------- //
+
+#include <stdio.h>  // perror, printf
+#include <stdlib.h>
+#include <string.h>  // mem allocation
+#include <ctype.h>  // isdigit
+#include <errno.h>  // EINTR
+#include <fcntl.h>  // open
+#include <unistd.h>  // fork, close, execv, getpid
+#include <sys/types.h>  // pid_t
+#include <sys/wait.h>  // waitpid
+#include <sys/stat.h>  // stat
+#include <signal.h>  // Signal handlers
+#include <poll.h>  // poll
+#include <sys/syscall.h>  // pidfd_open
+#include "src/shell_info.h"  // shell info struct
+#include "src/options.h"  // command line options
+#include "src/journal.h"  // --journal / --resume
+#include "src/bench.h"  // --startup-bench
+#include "src/builtins.h"  // builtin table and plugins
+#include "src/arg_vec.h"  // growable argument lists
+#include "src/alias.h"  // aliases and functions
+#include "src/arena.h"  // per-command allocations
+#include "src/arg_max.h"  // exec argument size limits
+#include "src/xargs.h"  // xargs builtin
+#include "src/dirs.h"  // cwd and directory fds
+#include "src/exec_cache.h"  // executable fds
+#include "src/lookahead.h"  // script prefetching
+#include "src/reader.h"  // script reader threads
+#include "src/snapshot.h"  // compiled startup file
+#include "src/command.h"  // ( ... ) and { ...; } groups
+#include "src/fds.h"  // exec N>file descriptors
+#include "src/jobs.h"  // background job statuses
+#include "src/jobserver.h"  // make -j token sharing
+#include "src/sched.h"  // job priorities
+#include "src/pressure.h"  // PSI limits for & jobs
+#include "src/ratelimit.h"  // --spawn-rate token bucket
+#include "src/reaper.h"  // --init subreaper mode
+#include "src/mux.h"  // --prefix-output for & jobs
+
+// --------------------- Function Prototypes --------------------- //
+int run_file(const char* path, struct shell_info *info);
+int is_self_script(char* args[], struct exec_target *target);
+int sub_shell(char* args[], int token);
+void detach_script(int token);
+int run_list(struct command* list, struct shell_info *info);
+int run_line(char* words[], struct shell_info *info);
+void small_shell(struct shell_options *opts);
+void parse_tokens(char* tokens[], struct shell_info *info, struct arg_vec *args);
+int execute_cmd(char* args[], struct shell_info *info);
+void other_cmd(char* args[], struct shell_info *info);
+void split_cmd(char* args[], struct shell_info *info, long limit);
+void spawn_cmd(char* args[], struct shell_info *info);
+void start_cmd(char* args[], struct shell_info *info, int background, int token);
+void launch_queued(char* args[], struct command* group, struct shell_info *info, int token);
+void start_group(struct command* c, struct shell_info *info, int background, int token);
+void fd_redirection(int n, int to);
+void job_done(pid_t pid, int status);
+void reap_jobs();
+pid_t wait_foreground(pid_t pid, int *status);
+void custom_SIGINT();
+void custom_IG();
+
+// Global variable declaration for custom Signal Handler
+int stop_background;
+
+// Running a ( ... ) or forked group: exit only leaves it, quietly
+int in_group = 0;
+
+// Memory for the command being run: arguments, tokens and expansions
+// All of it is released at once when the command finishes
+struct arena cmd_arena;
+
+// ---------------------- Helper Functions ----------------------- //
+
+// --------------------------------------------------------------- //
+// function   : void print_args(..)
+// parameters : char* args[]
+// description: Prints arguments stored in an array of char pointers
+// --------------------------------------------------------------- //
+void print_args(char* args[]) {
+	int i = 0;
+	while (args[i]) {
+		printf("%s \n", args[i]);
+		i++;
+	}
+}
+
+
+// --------------------------------------------------------------- //
+// function   : free_memory(..)
+// parameters : struct cmd_desc* line
+// description: Frees dynamically allocated memory for a command
+// --------------------------------------------------------------- //
+void free_memory(struct cmd_desc* line) {
+	free(line);
+	line = NULL;
+
+	arena_reset(&cmd_arena);  // Frees the arguments in one step
+}
+
+
+// ------------------- Built-In Shell Functions ------------------ //
+
+// --------------------------------------------------------------- //
+// function   : my_exit()
+// parameters : None
+// description: Ends the shell program when user enters 'exit' cmd
+//              In a group it only ends the group, with no message
+// --------------------------------------------------------------- //
+int my_exit() {
+	if (in_group)
+		return 0;
+
+	printf("exiting shell \n");
+
+	// flush after every display to stdout to show all output
+	fflush(stdout);
+
+	return 0;  // terminates smallsh by ending do-while loop
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_cd(..)
+// parameters : char* args []
+// description: Changes directory. If no argument is entered, makes
+//              the current working directory (CWD) to environment
+//              variable HOME. Otherwise, sets CWD to argument
+//              Switches by directory fd, see dirs.c
+// example    : cd Documents/Code-Projects/my_c_shell
+//              Returns 1 on failure, for && and ||
+// --------------------------------------------------------------- //
+int my_cd(char* args[]) {
+	if (!args[1]) {  // No arguments, set directory to HOME
+		char* home = getenv("HOME");
+
+		if (!home || dir_cd(home) != 0) {
+			printf("chdir() failed");  // Display in event of error
+			return 1;
+		}
+
+	} else {
+		if (dir_cd(args[1]) != 0) {
+			printf("chdir() failed");
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_pushd(..)
+// parameters : char* args[]
+// description: Pushes the CWD on the directory stack and changes to
+//              the argument, or swaps with the top with no argument
+//              Prints the stack like dirs
+// example    : pushd /tmp
+// --------------------------------------------------------------- //
+int my_pushd(char* args[]) {
+	if (dir_pushd(args[1]) != 0) {
+		perror("pushd");
+		return 1;
+	}
+
+	dir_print_stack();
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_popd()
+// parameters : none
+// description: Returns to the directory on top of the stack
+// --------------------------------------------------------------- //
+int my_popd() {
+	if (dir_popd() != 0) {
+		perror("popd");
+		return 1;
+	}
+
+	dir_print_stack();
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_status(..)
+// parameters : int exit_status
+// description: Prints out either the exit status or the terminating
+//              signal of the last foreground process ran by the shell
+//              Decodes status by using termination MACROS
+// --------------------------------------------------------------- //
+void my_status(int exit_status) {
+	if (WIFEXITED(exit_status)) {
+		printf("exit value %d \n", WEXITSTATUS(exit_status));
+		fflush(stdout);
+
+	} else {
+		printf("terminated by signal %d \n", WTERMSIG(exit_status));
+		fflush(stdout);
+	}
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_enable(..)
+// parameters : char* args[]
+// description: Loads builtins from a plugin shared object with -f, or
+//              lists builtins when given no arguments
+// example    : enable -f ./plugins/echo.so
+// --------------------------------------------------------------- //
+int my_enable(char* args[]) {
+	if (!args[1]) {
+		list_builtins();
+		return 0;
+	}
+
+	if (strcmp(args[1], "-f") == 0 && args[2])
+		return load_plugin(args[2]) == 0 ? 0 : 1;
+
+	printf("usage: enable [-f file.so] \n");
+	fflush(stdout);
+	return 2;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_alias(..)
+// parameters : char* args[]
+// description: Defines an alias when given name=words, prints one
+//              when given a name, or lists all with no arguments
+//              The expansion is stored already split into words
+// example    : alias ll=ls -l
+// --------------------------------------------------------------- //
+int my_alias(char* args[]) {
+	if (!args[1]) {
+		alias_list();
+		return 0;
+	}
+
+	char* eq = strchr(args[1], '=');
+
+	if (!eq) {
+		alias_print(args[1]);
+		return 0;
+	}
+
+	char* name = args[1];
+	int n = 0;  // Words after name=
+	while (args[n + 2])
+		n++;
+
+	*eq = '\0';
+
+	if (!eq[1])  // alias name= word...
+		return alias_define(name, args + 2, n) ? 1 : 0;
+
+	args[1] = eq + 1;  // First word of the expansion follows the '='
+	int ret = alias_define(name, args + 1, n + 1);
+	args[1] = name;  // Leave args as parsed
+
+	return ret ? 1 : 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_unalias(..)
+// parameters : char* args[]
+// description: Removes each named alias or function
+// --------------------------------------------------------------- //
+int my_unalias(char* args[]) {
+	int ret = 0;
+
+	for (int i = 1; args[i]; i++) {
+		if (alias_remove(args[i]) != 0) {
+			printf("unalias: %s not found \n", args[i]);
+			fflush(stdout);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : call_function(..)
+// parameters : struct builtin* self
+//              char* args[]
+//              struct shell_info *info
+// description: Runs a user function. Its stored body tokens are
+//              spliced with the call's arguments and executed like a
+//              typed command, without parsing the body text again
+// --------------------------------------------------------------- //
+int call_function(struct builtin* self, char* args[], struct shell_info *info) {
+	static int depth = 0;  // Guards against runaway recursion
+	struct shell_info call_info;
+	struct arg_vec tokens;
+	struct arg_vec call_args;
+	int status = 1;
+
+	if (depth >= 100) {
+		printf("%s: maximum function nesting reached \n", args[0]);
+		fflush(stdout);
+		info->exit_status = 1 << 8;
+		return 1;
+	}
+
+	arg_vec_init(&tokens, &cmd_arena);  // Released with the calling command
+	arg_vec_init(&call_args, &cmd_arena);
+	init_shell_info(&call_info);
+	call_info.exit_status = info->exit_status;
+
+	template_splice(&tokens, self->data, args);
+	parse_tokens(tokens.items, &call_info, &call_args);
+
+	depth++;
+	status = execute_cmd(call_args.items, &call_info);
+	depth--;
+
+	info->exit_status = call_info.exit_status;
+
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_function(..)
+// parameters : char* args[]
+// description: Defines a function. The body is kept as tokens, with
+//              $1-$9, $@ and $# filled in from each call's arguments
+// example    : function greet { echo hello $1 }
+// --------------------------------------------------------------- //
+int my_function(char* args[]) {
+	int n = 0;
+	while (args[n])
+		n++;
+
+	char* name = args[1];
+	int open = 2;
+
+	if (n >= 3 && strcmp(args[2], "()") == 0)  // function name () { ... }
+		open = 3;
+
+	if (n < open + 2 || strcmp(args[open], "{") != 0 || strcmp(args[n - 1], "}") != 0) {
+		printf("usage: function name { command } \n");
+		fflush(stdout);
+		return 2;
+	}
+
+	size_t len = strlen(name);
+	if (len > 2 && strcmp(name + len - 2, "()") == 0)  // function name() { ... }
+		name[len - 2] = '\0';
+
+	return function_define(name, args + open + 1, n - open - 2, call_function) ? 1 : 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_export(..)
+// parameters : char* args[]
+// description: Sets environment variables for the shell and every
+//              command it runs. Without arguments, lists them
+// example    : export EDITOR=vi
+// --------------------------------------------------------------- //
+int my_export(char* args[]) {
+	extern char** environ;
+	int ret = 0;
+
+	if (!args[1]) {
+		for (char** e = environ; *e; e++)
+			printf("export %s\n", *e);
+		fflush(stdout);
+		return 0;
+	}
+
+	for (int i = 1; args[i]; i++) {
+		char* eq = strchr(args[i], '=');
+
+		if (!eq)  // export NAME: already in the environment, or unset
+			continue;
+
+		*eq = '\0';
+		if (eq == args[i] || setenv(args[i], eq + 1, 1) == -1) {
+			printf("export: bad variable name %s \n", args[i]);
+			fflush(stdout);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_unset(..)
+// parameters : char* args[]
+// description: Removes environment variables
+// example    : unset EDITOR
+// --------------------------------------------------------------- //
+int my_unset(char* args[]) {
+	int ret = 0;
+
+	for (int i = 1; args[i]; i++) {
+		if (unsetenv(args[i]) == -1) {
+			printf("unset: bad variable name %s \n", args[i]);
+			fflush(stdout);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_source(..)
+// parameters : char* args[]
+//              struct shell_info *info
+// description: Runs a script in the current shell, so its cd, export,
+//              aliases and functions stay in effect afterwards
+//              Returns 0 if the script ran exit
+// example    : source ~/env.smallsh  or  . ~/env.smallsh
+// --------------------------------------------------------------- //
+int my_source(char* args[], struct shell_info *info) {
+	static int depth = 0;  // Guards against a script sourcing itself
+	int status;
+
+	if (!args[1]) {
+		printf("usage: source file \n");
+		fflush(stdout);
+		info->exit_status = 2 << 8;
+		return 1;
+	}
+
+	if (depth >= 100) {
+		printf("%s: maximum source nesting reached \n", args[1]);
+		fflush(stdout);
+		info->exit_status = 1 << 8;
+		return 1;
+	}
+
+	depth++;
+	status = run_file(args[1], info);
+	depth--;
+
+	if (status == -1) {
+		perror(args[1]);
+		info->exit_status = 1 << 8;
+		return 1;
+	}
+
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : job_done(..)
+// parameters : pid_t pid
+//              int status
+// description: Reports a reaped background job and keeps its status
+//              for wait
+// --------------------------------------------------------------- //
+void job_done(pid_t pid, int status) {
+	printf("background pid %d is done: ", pid);
+	fflush(stdout);
+	my_status(status);  // Print how child terminated
+
+	jobs_reaped(pid, status);
+	journal_job_done(pid);  // May complete the command that started it
+	sched_forget(pid);  // In case it was killed while stopped
+	sched_free(jobserver_release(pid));  // Its token goes to a waiting job, or back to make
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reap_jobs()
+// parameters : none
+// description: Reaps background jobs that are done, without waiting
+//              Their statuses go to the job table, info keeps the
+//              foreground one
+// --------------------------------------------------------------- //
+void reap_jobs() {
+	int corpse;
+	int corpse_status;
+
+	while ((corpse = reaper_wait(-1, &corpse_status, WNOHANG)) > 0)
+		job_done(corpse, corpse_status);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : wait_foreground(..)
+// parameters : pid_t pid
+//              int *status
+// description: Waits for the foreground command pid, like
+//              reaper_wait(). While & jobs are queued behind pressure
+//              or the spawn rate, it polls the child's pidfd with a
+//              timeout of when they may go, and starts them then, so
+//              a long command doesn't hold them back. Without pidfds
+//              (before Linux 5.3) they wait for the command to end
+// --------------------------------------------------------------- //
+pid_t wait_foreground(pid_t pid, int *status) {
+	int timeout = sched_next_ms();
+	int fd = timeout == -1 ? -1 : syscall(SYS_pidfd_open, pid, 0);
+
+	if (fd != -1) {
+		struct pollfd exited = { .fd = fd, .events = POLLIN };
+		int n;
+
+		while (timeout != -1 && ((n = poll(&exited, 1, timeout)) == 0 || (n == -1 && errno == EINTR))) {
+			if (n == 0)
+				sched_pump(0, reap_jobs);  // Doesn't reap without blocking, pid stays ours
+			timeout = sched_next_ms();
+		}
+
+		close(fd);
+	}
+
+	return reaper_wait(pid, status, 0);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : wait_job()
+// parameters : none
+// description: Blocks until a child exits and records it
+//              Returns -1 once there are no children left
+// --------------------------------------------------------------- //
+int wait_job() {
+	int status;
+	pid_t pid;
+
+	while ((pid = reaper_wait(-1, &status, 0)) == -1) {
+		if (errno != EINTR) {
+			jobs_forget_running();  // Reaped elsewhere, they won't show up
+			return -1;
+		}
+	}
+
+	job_done(pid, status);
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_wait(..)
+// parameters : char* args[]
+//              struct shell_info *info
+// description: Waits for background jobs, blocking in waitpid()
+//              With -n, for the next job to finish (or the oldest one
+//              already finished) and takes its status, 127 if there
+//              are no jobs. Otherwise for all of them, and fails if
+//              any of them failed; --summary also prints the counts
+// example    : wait -n  or  wait --all --summary
+// --------------------------------------------------------------- //
+void my_wait(char* args[], struct shell_info *info) {
+	int next = 0;
+	int summary = 0;
+
+	for (int i = 1; args[i]; i++) {
+		if (strcmp(args[i], "-n") == 0)
+			next = 1;
+		else if (strcmp(args[i], "--summary") == 0)
+			summary = 1;
+		else if (strcmp(args[i], "--all") != 0) {
+			printf("usage: wait [-n | --all [--summary]] \n");
+			fflush(stdout);
+			info->exit_status = 2 << 8;
+			return;
+		}
+	}
+
+	if (next) {
+		int status;
+
+		while (!jobs_next_done(&status)) {
+			if (jobs_running() && !sched_held())
+				wait_job();
+			else if (sched_pending())
+				sched_pump(1, reap_jobs);  // Queued, waiting for a token
+			else {
+				info->exit_status = 127 << 8;  // Nothing to wait for
+				return;
+			}
+		}
+
+		info->exit_status = status;
+		return;
+	}
+
+	int succeeded, failed;
+
+	while (jobs_running() || sched_pending()) {
+		if (jobs_running() && !sched_held())  // Else look at pressure now and then
+			wait_job();
+		else
+			sched_pump(1, reap_jobs);
+	}
+
+	jobs_collect(&succeeded, &failed);
+
+	if (summary) {
+		printf("%d jobs: %d succeeded, %d failed \n", succeeded + failed, succeeded, failed);
+		fflush(stdout);
+	}
+
+	info->exit_status = (failed ? 1 : 0) << 8;
+}
+
+
+// Builtin table entries, see builtins.h
+int builtin_exit(struct builtin* self, char* args[], struct shell_info *info) {
+	return my_exit();
+}
+
+int builtin_cd(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_cd(args) << 8;
+	return 1;
+}
+
+int builtin_status(struct builtin* self, char* args[], struct shell_info *info) {
+	my_status(info->exit_status);
+	return 1;
+}
+
+int builtin_enable(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_enable(args) << 8;
+	return 1;
+}
+
+int builtin_alias(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_alias(args) << 8;
+	return 1;
+}
+
+int builtin_unalias(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_unalias(args) << 8;
+	return 1;
+}
+
+int builtin_function(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_function(args) << 8;
+	return 1;
+}
+
+int builtin_xargs(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_xargs(args, info) << 8;
+	return 1;
+}
+
+int builtin_pushd(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_pushd(args) << 8;
+	return 1;
+}
+
+int builtin_popd(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_popd() << 8;
+	return 1;
+}
+
+int builtin_dirs(struct builtin* self, char* args[], struct shell_info *info) {
+	dir_print_stack();
+	return 1;
+}
+
+int builtin_source(struct builtin* self, char* args[], struct shell_info *info) {
+	return my_source(args, info);
+}
+
+int builtin_export(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_export(args) << 8;
+	return 1;
+}
+
+int builtin_unset(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = my_unset(args) << 8;
+	return 1;
+}
+
+int builtin_stats(struct builtin* self, char* args[], struct shell_info *info) {
+	reader_print_stats();
+	lookahead_print_stats();
+	jobserver_print_stats();
+	sched_print_stats();
+	pressure_print_stats();
+	ratelimit_print_stats();
+	reaper_print_stats();
+	mux_print_stats();
+	return 1;
+}
+
+int builtin_group(struct builtin* self, char* args[], struct shell_info *info) {
+	return run_line(args, info);
+}
+
+int builtin_wait(struct builtin* self, char* args[], struct shell_info *info) {
+	my_wait(args, info);
+	return 1;
+}
+
+int builtin_exec(struct builtin* self, char* args[], struct shell_info *info) {
+	info->exit_status = fds_exec(args) << 8;
+	return 1;
+}
+
+int builtin_hash(struct builtin* self, char* args[], struct shell_info *info) {
+	if (args[1] && strcmp(args[1], "-r") == 0)  // Forget all commands
+		exec_cache_clear();
+	else
+		exec_cache_print();
+	return 1;
+}
+
+
+// Shell builtins, placed by perfect hash (see builtins.h)
+static const struct builtin core_builtins[BUILTIN_SLOTS] = {
+	[BUILTIN_HASH(4, 'e', 't')] = { "exit",   BUILTIN_SHELL, builtin_exit },
+	[BUILTIN_HASH(2, 'c', 'd')] = { "cd",     BUILTIN_SHELL, builtin_cd },
+	[BUILTIN_HASH(6, 's', 's')] = { "status", BUILTIN_SHELL, builtin_status },
+	[BUILTIN_HASH(6, 'e', 'e')] = { "enable", BUILTIN_SHELL, builtin_enable },
+	[BUILTIN_HASH(5, 'a', 's')] = { "alias",  BUILTIN_SHELL, builtin_alias },
+	[BUILTIN_HASH(7, 'u', 's')] = { "unalias", BUILTIN_SHELL, builtin_unalias },
+	[BUILTIN_HASH(8, 'f', 'n')] = { "function", BUILTIN_SHELL, builtin_function },
+	[BUILTIN_HASH(5, 'x', 's')] = { "xargs",  BUILTIN_SHELL, builtin_xargs },
+	[BUILTIN_HASH(5, 'p', 'd')] = { "pushd",  BUILTIN_SHELL, builtin_pushd },
+	[BUILTIN_HASH(4, 'p', 'd')] = { "popd",   BUILTIN_SHELL, builtin_popd },
+	[BUILTIN_HASH(4, 'd', 's')] = { "dirs",   BUILTIN_SHELL, builtin_dirs },
+	[BUILTIN_HASH(4, 'h', 'h')] = { "hash",   BUILTIN_SHELL, builtin_hash },
+	[BUILTIN_HASH(5, 's', 's')] = { "stats",  BUILTIN_SHELL, builtin_stats },
+	[BUILTIN_HASH(6, 'e', 't')] = { "export", BUILTIN_SHELL, builtin_export },
+	[BUILTIN_HASH(5, 'u', 't')] = { "unset",  BUILTIN_SHELL, builtin_unset },
+	[BUILTIN_HASH(6, 's', 'e')] = { "source", BUILTIN_SHELL, builtin_source },
+	[BUILTIN_HASH(1, '.', '.')] = { ".",      BUILTIN_SHELL, builtin_source },
+	[BUILTIN_HASH(1, '{', '{')] = { "{",      BUILTIN_SHELL, builtin_group },
+	[BUILTIN_HASH(1, '(', '(')] = { "(",      BUILTIN_SHELL, builtin_group },
+	[BUILTIN_HASH(4, 'e', 'c')] = { "exec",   BUILTIN_SHELL, builtin_exec },
+	[BUILTIN_HASH(4, 'w', 't')] = { "wait",   BUILTIN_SHELL, builtin_wait },
+};
+
+
+// --------------------------------------------------------------- //
+// function   : init_builtins()
+// parameters : none
+// description: Installs the shell's own builtins, then loads plugins
+//              named in SMALLSH_PLUGINS
+// --------------------------------------------------------------- //
+void init_builtins() {
+	set_core_builtins(core_builtins);
+
+	load_plugins_env();
+}
+
+
+// ------------------ I/O Redirection Functions ------------------ //
+
+// --------------------------------------------------------------- //
+// function   : output_redirection(..)
+// parameters : char* filename
+//              int append
+// description: Redirects output from stdout to the passed in file
+//              Truncates it unless append is set
+// reference  : Handling input/output redirection
+//              https://stackoverflow.com/a/11518304/10895933
+// --------------------------------------------------------------- //
+void output_redirection(char* filename, int append) {
+	// Open file and set permissions
+	int fd = dir_open(filename, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0777);
+
+	if (fd == -1) {  // Error checking
+		perror("Output file could not be opened \n");  // Print error message
+		_exit(1);  // Set the exit status to 1
+	}
+
+	int d = dup2(fd, 1);  // Direct output to file descriptor
+
+	if (d == -1) {
+		perror("Output file could not be redirected");
+		_exit(1);
+	}
+
+	close(fd);  // Close file
+}
+
+
+// --------------------------------------------------------------- //
+// function   : input_redirection(..)
+// parameters : char* filename
+// description: Redirects input from stdin to the passed in file
+// reference  : Handling input/output redirection
+//              https://stackoverflow.com/a/11518304/10895933
+// --------------------------------------------------------------- //
+void input_redirection(char* filename) {
+	// Open file and set permissions
+	int fd = dir_open(filename, O_RDONLY, 0);
+
+	if (fd == -1) {  // Error checking
+		perror("Input file could not be opened \n");  // Print error message
+		_exit(1);  // Set the exit status to 1
+	}
+
+	int d = dup2(fd, 0);  // Direct output to file descriptor
+
+	if (d == -1) {
+		perror("Input file could not be redirected");
+		_exit(0);
+	}
+
+	close(fd);  // Close file
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fd_redirection(..)
+// parameters : int n
+//              int to
+// description: Points stdin or stdout (to) at descriptor n, one the
+//              shell holds from exec or inherited. For >&N and <&N
+// example    : make >&3
+// --------------------------------------------------------------- //
+void fd_redirection(int n, int to) {
+	if (dup2(fds_get(n), to) == -1) {
+		fprintf(stderr, "%d: ", n);
+		perror("bad file descriptor");
+		_exit(1);
+	}
+}
+
+
+// -------------------- User Input Functions --------------------- //
+
+// --------------------------------------------------------------- //
+// function   : get_input(..)
+// parameters : FILE* in
+//              int prompt
+// description: Gets input from user, or the next line of a script
+//              Prompts only when reading from the user
+//              Allocates memory, as much as the line needs
+//              Returns user input split into words, or NULL at end of
+//              input. Scripts are read through reader_next() instead
+// references : remove newline from fgets - https://stackoverflow.com/a/2693826/10895933
+// --------------------------------------------------------------- //
+struct cmd_desc* get_input(FILE* in, int prompt) {
+	char* line = NULL;
+	size_t size = 0;
+
+	if (prompt) {
+		printf(": ");  // Prompt user
+		fflush(stdout);
+	}
+
+	if (getline(&line, &size, in) == -1) {  // Get input from user
+		free(line);
+		return NULL;  // End of input
+	}
+
+	strtok(line, "\n");  // Remove newline
+
+	struct cmd_desc* cmd = cmd_desc_parse(line);  // Split into words
+	free(line);
+
+	return cmd;  // return user input
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_definition(..)
+// parameters : char* tokens[]
+// description: Returns 1 if tokens define an alias or function. Their
+//              bodies are stored as written, so <, >, & and $$ must not
+//              be acted on when the definition itself is parsed
+// --------------------------------------------------------------- //
+int is_definition(char* tokens[]) {
+	size_t len = strlen(tokens[0]);
+
+	return strcmp(tokens[0], "alias") == 0 || strcmp(tokens[0], "function") == 0 ||
+	       (len > 2 && strcmp(tokens[0] + len - 2, "()") == 0);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : expand_alias(..)
+// parameters : struct arg_vec *tokens
+// description: Replaces a leading alias with its stored tokens. The
+//              expansion may itself start with an alias, but a name is
+//              never expanded twice (so alias ls=ls -F works)
+// --------------------------------------------------------------- //
+void expand_alias(struct arg_vec *tokens) {
+	struct arg_vec spliced;
+	char* seen[16];
+	int depth = 0;
+
+	arg_vec_init(&spliced, &cmd_arena);
+
+	while (tokens->len && depth < 16) {
+		struct builtin* b = find_builtin(tokens->items[0]);
+
+		if (!b || b->kind != BUILTIN_ALIAS)
+			break;
+
+		for (int i = 0; i < depth; i++)
+			if (seen[i] == b->name)
+				return;
+		seen[depth++] = b->name;
+
+		struct template* t = b->data;
+		arg_vec_reset(&spliced);
+
+		for (int i = 0; i < t->len; i++)
+			arg_vec_push(&spliced, t->tokens[i]);
+		for (int i = 1; i < tokens->len; i++)
+			arg_vec_push(&spliced, tokens->items[i]);
+
+		arg_vec_reset(tokens);
+		for (int i = 0; i < spliced.len; i++)
+			arg_vec_push(tokens, spliced.items[i]);
+	}
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_variable(..)
+// parameters : char* token
+// description: Returns 1 if token is a whole $NAME reference
+// --------------------------------------------------------------- //
+int is_variable(char* token) {
+	const char* name_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz_0123456789";
+
+	return token[0] == '$' && token[1] && !isdigit((unsigned char) token[1]) &&
+	       token[1 + strspn(token + 1, name_chars)] == '\0';
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_fd_dup(..)
+// parameters : char* token
+// description: Returns 1 if token is >&N or <&N, N from 0 to 9
+// --------------------------------------------------------------- //
+int is_fd_dup(char* token) {
+	return (token[0] == '>' || token[0] == '<') && token[1] == '&' &&
+	       isdigit((unsigned char) token[2]) && !token[3];
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_group(..)
+// parameters : char* tokens[]
+// description: Returns 1 if tokens start a ( ... ) or { ...; } group
+// --------------------------------------------------------------- //
+int is_group(char* tokens[]) {
+	return tokens[0] && (tokens[0][0] == '(' || strcmp(tokens[0], "{") == 0);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_list(..)
+// parameters : char* tokens[]
+// description: Returns 1 if tokens hold several commands joined by
+//              ; && or ||. A definition's body is not split here
+// --------------------------------------------------------------- //
+int is_list(char* tokens[]) {
+	if (!tokens[0] || is_definition(tokens))
+		return 0;
+
+	for (int i = 0; tokens[i]; i++) {
+		size_t len = strlen(tokens[i]);
+
+		if ((len && tokens[i][len - 1] == ';') || strcmp(tokens[i], "&&") == 0 || strcmp(tokens[i], "||") == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_tokens(..)
+// parameters : char* tokens[]
+//              struct shell_info *info
+//              struct arg_vec *args
+// description: Turns a NULL terminated list of words into a command
+//              Records redirections (< > <&N >&N), background flag and
+//              a leading -p priority in info
+//              Expands $$ and whole-word $NAME references
+//              Allocates memory for each argument
+//              Stores arguments into args
+//              Groups and lists are kept as written for run_line(),
+//              each of their commands is parsed on its own when it runs
+// --------------------------------------------------------------- //
+void parse_tokens(char* tokens[], struct shell_info *info, struct arg_vec *args) {
+	char* token;
+	int i = 0;
+
+	if (is_group(tokens) || is_list(tokens)) {
+		if (tokens[0][0] == '(' && tokens[0][1]) {  // (cmd: look up the ( builtin
+			arg_vec_push(args, "(");
+			arg_vec_push_copy(args, tokens[i++] + 1);
+		}
+
+		while (tokens[i])
+			arg_vec_push_copy(args, tokens[i++]);
+		return;
+	}
+
+	while ((token = tokens[i++])) {
+
+		if (strcmp(token, "<") == 0 && tokens[i]) {  // Identify any input file
+			info->input_redirect = 1;  // Set input file flag
+			token = tokens[i++];  // Get filename
+			snprintf(info->input_filename, sizeof(info->input_filename), "%s", token);  // Save filename
+
+		} else if (strcmp(token, ">") == 0 && tokens[i]) {  // Repeat for potential outfile
+			info->output_redirect = 1;
+			token = tokens[i++];
+			snprintf(info->output_filename, sizeof(info->output_filename), "%s", token);
+
+		} else if (is_fd_dup(token)) {  // >&N or <&N, a descriptor held by exec
+			if (token[0] == '>')
+				info->output_fd = token[2] - '0';
+			else
+				info->input_fd = token[2] - '0';
+
+		} else if (strcmp(token, "&") == 0 && args->len) {  // Identify background flag
+			info->background = 1;
+
+		} else if (!args->len && strcmp(token, "-p") == 0 && tokens[i] && sched_level(tokens[i]) != -1) {
+			info->priority = sched_level(tokens[i++]);  // -p low cmd
+
+		} else if (strcmp(token, "$$") == 0) {  // Changes $$ to pid
+			char pid[12];
+			sprintf(pid, "%d", getpid());
+			arg_vec_push_copy(args, pid);
+
+		} else if (is_variable(token)) {  // $NAME from the environment
+			char* value = getenv(token + 1);
+
+			if (value && value[0])  // Unset or empty leaves no word
+				arg_vec_push_copy(args, value);
+
+		} else {
+			arg_vec_push_copy(args, token);  // Bloc saves arguments for rest of line
+		}
+	}
+
+	if (!args->len)  // Nothing left to run, treat like a blank line
+		arg_vec_push(args, "\n");
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_words(..)
+// parameters : struct arg_vec *tokens
+//              struct shell_info *info
+//              struct arg_vec *args
+// description: Turns the words of one command into its arguments:
+//              definitions are kept as written, anything else has a
+//              leading alias expanded and goes through parse_tokens
+//              Aliases in a group or list are expanded per command,
+//              as each one runs
+// --------------------------------------------------------------- //
+void parse_words(struct arg_vec *tokens, struct shell_info *info, struct arg_vec *args) {
+	if (!tokens->len) {  // Only spaces
+		arg_vec_push(args, "\n");
+		return;
+	}
+
+	if (is_definition(tokens->items)) {  // Keep the body exactly as written
+		if (strcmp(tokens->items[0], "alias") != 0 && strcmp(tokens->items[0], "function") != 0)
+			arg_vec_push(args, "function");  // name() { ... }
+
+		for (int i = 0; i < tokens->len; i++)
+			arg_vec_push_copy(args, tokens->items[i]);
+		return;
+	}
+
+	if (!is_group(tokens->items) && !is_list(tokens->items))
+		expand_alias(tokens);
+
+	parse_tokens(tokens->items, info, args);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_line(..)
+// parameters : struct cmd_desc* line
+//              struct shell_info *info
+//              struct arg_vec *args
+// description: Takes a line already split into tokens delimited by " "
+//              Expands a leading alias
+//              Stores the resulting command into args
+//              Aliases depend on earlier lines having run, so this is
+//              done here and not ahead of time by the parser thread
+// --------------------------------------------------------------- //
+void parse_line(struct cmd_desc* line, struct shell_info *info, struct arg_vec *args) {
+	struct arg_vec tokens;  // Points into line or alias templates
+
+	arg_vec_init(&tokens, &cmd_arena);
+
+	for (int i = 0; i < line->len; i++)
+		arg_vec_push(&tokens, line->tokens[i]);
+
+	parse_words(&tokens, info, args);
+}
+
+
+// ------------------ Execute Commands Functions ----------------- //
+
+// --------------------------------------------------------------- //
+// function   : execute_cmd(..)
+// parameters : char* args[]
+//              struct shell_info *info
+// description: Executes command stored in arguments
+//              Follows arguments appropriately
+//              A line of commands joined by ; && || is parsed once
+//              and run as a list, see run_line()
+// --------------------------------------------------------------- //
+int execute_cmd(char* args[], struct shell_info *info) {
+	int status = 1;  // Return this to indicate if shell should continue
+	struct builtin* b;
+
+	// Check for comments/blank lines, then built in functions
+	// If not, then execute other command via other_cmd(..)
+	if (strcmp(args[0], "\n") == 0 || args[0][0] == '#') {  // Blank line or comment
+		// Do nothing
+
+	}	else if (is_list(args)) {  // cmd; cmd && cmd || cmd
+		status = run_line(args, info);
+
+	}	else if ((b = find_builtin(args[0])) && b->kind != BUILTIN_ALIAS) {  // Built in, plugin or function
+		status = run_builtin(b, args, info);
+
+	}	else {
+		other_cmd(args, info);  // Execute non-built in commands
+	}
+
+	reap_jobs();  // Wait for terminated children / clean up zombies
+	sched_pump(0, reap_jobs);  // Tokens make freed meanwhile, for queued jobs
+
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : void other_cmd(..)
+// parameters : char* args[]
+//              struct shell_info *info
+// description: This function executes shell commands that aren't
+//              build in. Commands with more arguments than one exec
+//              can take are split into several
+// --------------------------------------------------------------- //
+void other_cmd(char* args[], struct shell_info *info) {
+	long size = exec_args_size(args);
+
+	// Anything this small fits even ARG_MAX's POSIX minimum, skip
+	// walking the environment for the exact limit
+	if (size > 4096 && size > exec_arg_limit())
+		split_cmd(args, info, exec_arg_limit());
+	else
+		spawn_cmd(args, info);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : void split_cmd(..)
+// parameters : char* args[]
+//              struct shell_info *info
+//              long limit
+// description: Runs a command too large for one exec as several,
+//              xargs style. The command and its leading options are
+//              repeated in each batch and the remaining arguments are
+//              packed in up to limit bytes. Batches run one after
+//              another; the exit status is that of the last batch to
+//              fail, or 0
+// --------------------------------------------------------------- //
+void split_cmd(char* args[], struct shell_info *info, long limit) {
+	struct arg_vec batch;
+	long fixed_size = sizeof(char*) + exec_arg_size(args[0]);
+	int fixed = 1;
+	int failed = 0;
+	int i;
+
+	while (args[fixed] && args[fixed][0] == '-') {  // Leading options
+		fixed_size += exec_arg_size(args[fixed]);
+		fixed++;
+	}
+
+	arg_vec_init(&batch, &cmd_arena);
+
+	for (i = fixed; args[i]; ) {
+		long size = fixed_size;
+
+		arg_vec_reset(&batch);
+		for (int f = 0; f < fixed; f++)
+			arg_vec_push(&batch, args[f]);
+
+		do {  // Always take one, an argument too big alone fails in exec
+			size += exec_arg_size(args[i]);
+			arg_vec_push(&batch, args[i++]);
+		} while (args[i] && size + exec_arg_size(args[i]) <= limit);
+
+		spawn_cmd(batch.items, info);
+		info->output_append = 1;  // Later batches add to the first one's output
+
+		if (info->exit_status != 0)
+			failed = info->exit_status;
+	}
+
+	info->exit_status = failed;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : void spawn_cmd(..)
+// parameters : char* args[]
+//              struct shell_info *info
+// description: Runs one command. A & job may have to wait for a
+//              jobserver token, and is queued if none is free (see
+//              sched.c); anything else starts right away
+// --------------------------------------------------------------- //
+void spawn_cmd(char* args[], struct shell_info *info) {
+	int background = info->background && !stop_background;
+	int token = JOBSERVER_NONE;
+
+	if (background)
+		info->journal_index = journal_job();  // Recorded once it is reaped
+
+	if (background && (token = sched_admit(args, NULL, info)) == SCHED_QUEUED)
+		return;  // Started by launch_queued() once it has a token
+
+	start_cmd(args, info, background, token);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : void launch_queued(..)
+// parameters : char* args[]
+//              struct command* group
+//              struct shell_info *info
+//              int token
+// description: Starts a queued & job, command args or a group, for
+//              sched.c
+// --------------------------------------------------------------- //
+void launch_queued(char* args[], struct command* group, struct shell_info *info, int token) {
+	if (group)
+		start_group(group, info, 1, token);
+	else
+		start_cmd(args, info, 1, token);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : void start_cmd(..)
+// parameters : char* args[]
+//              struct shell_info *info
+//              int background
+//              int token
+// description: Forks and execs one command. Child processes are
+//              spawned and have different behavior via switch
+//              statement to faciliate this. A background job holds
+//              token until it is reaped
+// --------------------------------------------------------------- //
+void start_cmd(char* args[], struct shell_info *info, int background, int token) {
+	if (info->output_redirect)  // Let the child open it from a held directory
+		dir_warm(info->output_filename);
+	if (info->input_redirect)
+		dir_warm(info->input_filename);
+
+	struct exec_target target;  // Resolve the binary once, in the parent
+	exec_lookup(args[0], &target);
+
+	int self = is_self_script(args, &target);  // smallsh script, run it in the fork
+
+	int mux_in = -1;
+	int mux_out = background ? mux_pipe(&mux_in) : -1;  // With --prefix-output
+
+	fflush(stdout);  // Or the child writes it out again (a sub_shell, or any & job)
+
+	pid_t spawnPid = reaper_fork();  // Fork a new process
+
+	struct sigaction SIG_H = { 0 };  // For cusom signal handler
+
+	switch (spawnPid) {
+	case -1:
+		perror("fork() \n");
+		exit(1);
+		break;
+
+	case 0:  // In child process
+
+		custom_IG();  // Children ignore SIGTSTP
+		sched_apply(info->priority);  // nice, SCHED_IDLE and I/O class for -p
+
+		if (background) {
+			setpgid(0, 0);  // Its own group, so sched.c stops and continues all of it
+			printf("background pid is %d \n", getpid());  // Display background pid
+			fflush(stdout);
+
+			// Background cmd should use /dev/null for if input | output if respective redirection not specified
+			// With --prefix-output its output and errors go to the shell's pipe instead
+			if (!info->output_redirect && info->output_fd == -1 && mux_out == -1)
+				output_redirection("/dev/null", 0);
+			else if (!info->output_redirect && info->output_fd == -1)
+				dup2(mux_out, 1);
+
+			if (mux_out != -1) {
+				dup2(mux_out, 2);
+				close(mux_out);
+				close(mux_in);
+			}
+
+			if (!info->input_redirect && info->input_fd == -1)
+				input_redirection("/dev/null");
+
+		} else {
+			SIG_H.sa_handler = SIG_DFL;  // Restore ^C default functionality in child
+			sigfillset(&SIG_H.sa_mask);  // Only in foreground
+			SIG_H.sa_flags = SA_RESETHAND;
+			sigaction(SIGINT, &SIG_H, NULL);
+		}
+
+		// ------------------ I/O Redirection ------------------ //
+
+		if (info->input_redirect) {
+			input_redirection(info->input_filename);  // Input redirection if applicable
+		}
+
+		if (info->output_redirect) {
+			output_redirection(info->output_filename, info->output_append);  // Output redirection if applicable
+		}
+
+		// After the files above, which may open relative to an fd in the way
+		target.fd = fds_install(target.fd);  // Descriptors from exec N>file
+
+		if (info->input_fd != -1)
+			fd_redirection(info->input_fd, 0);
+
+		if (info->output_fd != -1)
+			fd_redirection(info->output_fd, 1);
+
+		// ------------------ Execute Command ------------------ //
+
+		if (self)
+			_exit(sub_shell(args, token));
+
+		exec_run(&target, args);  // Replace the current program with command (aka execute command)
+		perror("execvp");  // this only returns if there is an exec error
+		_exit(2);  // exit() would rewind the parent's script on the shared fd
+		break;
+
+	default:  // In parent process
+
+		if (background) {  // Run in background
+			setpgid(spawnPid, spawnPid);  // As the child does, whichever runs first
+			jobs_add(spawnPid);  // Reaped later, see execute_cmd and wait
+			journal_job_started(info->journal_index, spawnPid);
+			jobserver_started(spawnPid, token, info->priority);
+
+			if (mux_out != -1) {
+				close(mux_out);
+				mux_add(mux_in, spawnPid);
+			}
+
+		}	else {  // Run in foreground
+
+			lookahead_prefetch();  // Use the wait to warm up the next script lines
+
+			reaper_foreground(spawnPid);  // Gets the signals --init forwards
+			spawnPid = wait_foreground(spawnPid, &info->exit_status);  // Wait for child's termination
+			reaper_foreground(0);
+
+			if (info->exit_status != 0) {  // Print out abnormal exit if applicable
+				my_status(info->exit_status);
+			}
+
+		}
+		break;
+	}
+}
+
+
+// ----------------------- Command Groups ------------------------ //
+
+// --------------------------------------------------------------- //
+// function   : run_words(..)
+// parameters : char* words[]
+//              struct shell_info *info
+// description: Runs one command of a group as if it were a line of
+//              its own, with its own redirections and & flag
+//              Leaves its exit status in info
+// --------------------------------------------------------------- //
+int run_words(char* words[], struct shell_info *info) {
+	struct shell_info cmd_info;
+	struct arg_vec tokens;
+	struct arg_vec args;
+	int status;
+
+	init_shell_info(&cmd_info);
+	cmd_info.exit_status = info->exit_status;  // For status
+	arg_vec_init(&tokens, &cmd_arena);
+	arg_vec_init(&args, &cmd_arena);
+
+	for (int i = 0; words[i]; i++)
+		arg_vec_push(&tokens, words[i]);
+
+	parse_words(&tokens, &cmd_info, &args);
+	status = execute_cmd(args.items, &cmd_info);
+
+	info->exit_status = cmd_info.exit_status;
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : group_words(..)
+// parameters : char* words[]
+//              struct shell_info *info
+// description: Reads the words after a group's closing bracket into
+//              info: < file, > file, <&N, >&N and a final &
+//              Returns -1 on anything else
+// --------------------------------------------------------------- //
+int group_words(char* words[], struct shell_info *info) {
+	for (int i = 0; words[i]; i++) {
+		if (strcmp(words[i], "<") == 0 && words[i + 1]) {
+			info->input_redirect = 1;
+			snprintf(info->input_filename, sizeof(info->input_filename), "%s", words[++i]);
+
+		} else if (strcmp(words[i], ">") == 0 && words[i + 1]) {
+			info->output_redirect = 1;
+			snprintf(info->output_filename, sizeof(info->output_filename), "%s", words[++i]);
+
+		} else if (is_fd_dup(words[i])) {
+			if (words[i][0] == '>')
+				info->output_fd = words[i][2] - '0';
+			else
+				info->input_fd = words[i][2] - '0';
+
+		} else if (strcmp(words[i], "&") == 0 && !words[i + 1]) {
+			info->background = 1;
+
+		} else {
+			printf("syntax error near %s \n", words[i]);
+			fflush(stdout);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : redirect_group(..)
+// parameters : struct shell_info *info
+//              int saved[2]
+// description: Opens a group's redirections once and points stdin and
+//              stdout at them for every command in the group. The old
+//              descriptors are kept in saved for restore_group()
+//              Returns -1, with nothing changed, if a file won't open
+// --------------------------------------------------------------- //
+int redirect_group(struct shell_info *info, int saved[2]) {
+	int fds[2];
+
+	saved[0] = saved[1] = -1;
+
+	if (fds_open_io(info, fds) == -1)
+		return -1;
+
+	fflush(stdout);  // Output so far goes where it was headed
+
+	for (int i = 0; i < 2; i++) {
+		if (fds[i] == -1)
+			continue;
+
+		saved[i] = fcntl(i, F_DUPFD_CLOEXEC, 10);
+		dup2(fds[i], i);
+		close(fds[i]);
+	}
+
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : restore_group(..)
+// parameters : int saved[2]
+// description: Undoes redirect_group()
+// --------------------------------------------------------------- //
+void restore_group(int saved[2]) {
+	fflush(stdout);
+
+	for (int i = 0; i < 2; i++) {
+		if (saved[i] == -1)
+			continue;
+
+		dup2(saved[i], i);
+		close(saved[i]);
+	}
+}
+
+
+// --------------------------------------------------------------- //
+// function   : in_shell_only(..)
+// parameters : struct command* list
+// description: Returns 1 if every command of list, groups included,
+//              is a builtin whose effects a snapshot of the cwd and
+//              variables can undo, so a ( ... ) of them needs no fork
+// --------------------------------------------------------------- //
+int in_shell_only(struct command* list) {
+	for (struct command* c = list; c; c = c->next) {
+		if (c->kind != CMD_SIMPLE) {
+			if (!in_shell_only(c->body))
+				return 0;
+			continue;
+		}
+
+		struct builtin* b = find_builtin(c->words[0]);
+
+		if (!b || b->kind != BUILTIN_SHELL)
+			return 0;
+
+		if (b->fn != builtin_cd && b->fn != builtin_export && b->fn != builtin_unset &&
+		    b->fn != builtin_status && b->fn != builtin_exit && b->fn != builtin_dirs &&
+		    b->fn != builtin_stats)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : save_environ()
+// parameters : none
+// description: Returns a copy of the environment for restore_environ()
+// --------------------------------------------------------------- //
+char** save_environ() {
+	extern char** environ;
+	int n = 0;
+
+	while (environ && environ[n])
+		n++;
+
+	char** copy = malloc((n + 1) * sizeof(char*));
+
+	for (int i = 0; i < n; i++)
+		copy[i] = strdup(environ[i]);
+	copy[n] = NULL;
+
+	return copy;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : restore_environ(..)
+// parameters : char** copy
+// description: Replaces the environment with a save_environ() copy
+//              The strings become the environment's, only the array
+//              is freed
+// --------------------------------------------------------------- //
+void restore_environ(char** copy) {
+	clearenv();
+
+	for (int i = 0; copy[i]; i++)
+		putenv(copy[i]);
+
+	free(copy);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fork_group(..)
+// parameters : struct command* c
+//              struct shell_info *info
+// description: Runs a group in a forked copy of the shell, for
+//              ( ... ) and any group put in the background. A & group
+//              is admitted like a & command, and may be queued (see
+//              sched.c)
+// --------------------------------------------------------------- //
+void fork_group(struct command* c, struct shell_info *info) {
+	int background = info->background && !stop_background;
+	int token = JOBSERVER_NONE;
+
+	if (background)
+		info->journal_index = journal_job();
+
+	if (background && (token = sched_admit(NULL, c, info)) == SCHED_QUEUED)
+		return;  // Started by launch_queued() once it has a token
+
+	start_group(c, info, background, token);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : start_group(..)
+// parameters : struct command* c
+//              struct shell_info *info
+//              int background
+//              int token
+// description: Forks the copy of the shell that runs group c. The
+//              copy lets go of the script first (see detach_script)
+//              A background group holds token until it is reaped
+// --------------------------------------------------------------- //
+void start_group(struct command* c, struct shell_info *info, int background, int token) {
+	struct sigaction SIG_H = { 0 };
+
+	int mux_in = -1;
+	int mux_out = background ? mux_pipe(&mux_in) : -1;
+
+	fflush(stdout);  // Or the child writes it out again
+
+	pid_t spawnPid = reaper_fork();
+
+	switch (spawnPid) {
+	case -1:
+		perror("fork() \n");
+		exit(1);
+		break;
+
+	case 0:  // In child process
+		custom_IG();
+		detach_script(token);
+
+		if (background) {
+			setpgid(0, 0);
+			printf("background pid is %d \n", getpid());
+			fflush(stdout);
+
+			if (!info->output_redirect && info->output_fd == -1 && mux_out == -1)
+				output_redirection("/dev/null", 0);
+			else if (!info->output_redirect && info->output_fd == -1)
+				dup2(mux_out, 1);
+
+			if (mux_out != -1) {
+				dup2(mux_out, 2);
+				close(mux_out);
+				close(mux_in);
+			}
+
+			if (!info->input_redirect && info->input_fd == -1)
+				input_redirection("/dev/null");
+
+		} else {
+			SIG_H.sa_handler = SIG_DFL;
+			sigfillset(&SIG_H.sa_mask);
+			SIG_H.sa_flags = SA_RESETHAND;
+			sigaction(SIGINT, &SIG_H, NULL);
+		}
+
+		if (info->input_redirect)
+			input_redirection(info->input_filename);
+
+		if (info->output_redirect)
+			output_redirection(info->output_filename, 0);
+
+		if (info->input_fd != -1)
+			fd_redirection(info->input_fd, 0);
+
+		if (info->output_fd != -1)
+			fd_redirection(info->output_fd, 1);
+
+		in_group = 1;
+		run_list(c->body, info);
+		fflush(stdout);
+
+		_exit(WIFEXITED(info->exit_status) ? WEXITSTATUS(info->exit_status)
+		                                    : 128 + WTERMSIG(info->exit_status));
+		break;
+
+	default:  // In parent process
+		if (background) {
+			setpgid(spawnPid, spawnPid);
+			jobs_add(spawnPid);
+			journal_job_started(info->journal_index, spawnPid);
+			jobserver_started(spawnPid, token, info->priority);
+
+			if (mux_out != -1) {
+				close(mux_out);
+				mux_add(mux_in, spawnPid);
+			}
+
+		} else {
+			lookahead_prefetch();
+
+			reaper_foreground(spawnPid);
+			wait_foreground(spawnPid, &info->exit_status);
+			reaper_foreground(0);
+
+			if (WIFSIGNALED(info->exit_status))  // Failures inside already printed theirs
+				my_status(info->exit_status);
+		}
+		break;
+	}
+}
+
+
+// --------------------------------------------------------------- //
+// function   : run_group(..)
+// parameters : struct command* c
+//              struct shell_info *info
+// description: Runs a { ...; } or ( ... ) group with its redirections
+//              opened once for the whole group. A brace group runs in
+//              the shell. A subshell of only builtins runs in the shell
+//              too, with the cwd and variables put back afterwards;
+//              anything else forks, so its changes stay in the child
+//              Returns 0 if a brace group ran exit
+// --------------------------------------------------------------- //
+int run_group(struct command* c, struct shell_info *info) {
+	struct shell_info group_info;
+	int saved[2];
+	int status = 1;
+
+	init_shell_info(&group_info);
+	group_info.exit_status = info->exit_status;
+
+	if (group_words(c->words, &group_info) == -1) {
+		info->exit_status = 2 << 8;
+		return 1;
+	}
+
+	char* cwd_path = NULL;
+	int cwd_fd = -1;
+
+	if (c->kind == CMD_SUBSHELL && !(group_info.background && !stop_background) &&
+	    in_shell_only(c->body))
+		cwd_fd = dir_save(&cwd_path);
+
+	if (c->kind == CMD_SUBSHELL && cwd_fd == -1) {
+		fork_group(c, &group_info);
+
+	} else if (c->kind == CMD_BRACE && group_info.background && !stop_background) {
+		fork_group(c, &group_info);
+
+	} else if (redirect_group(&group_info, saved) == -1) {
+		group_info.exit_status = 1 << 8;
+		if (cwd_fd != -1)
+			dir_restore(cwd_path, cwd_fd);
+
+	} else if (c->kind == CMD_BRACE) {
+		status = run_list(c->body, &group_info);
+		restore_group(saved);
+
+	} else {  // Builtin-only subshell
+		char** env = save_environ();
+		int outer = in_group;
+
+		in_group = 1;
+		run_list(c->body, &group_info);  // exit only leaves the subshell
+		in_group = outer;
+		restore_group(saved);
+
+		dir_restore(cwd_path, cwd_fd);
+		restore_environ(env);
+	}
+
+	info->exit_status = group_info.exit_status;
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : run_list(..)
+// parameters : struct command* list
+//              struct shell_info *info
+// description: Runs the commands of a list one after another. After
+//              && the next runs only if the last one run succeeded,
+//              after || only if it failed, so a && b || c runs c when
+//              either a or b fails
+//              Returns 0 if one of them ran exit
+// --------------------------------------------------------------- //
+int run_list(struct command* list, struct shell_info *info) {
+	int status = 1;
+	int run = 1;
+
+	for (struct command* c = list; c && status; c = c->next) {
+		if (run)
+			status = c->kind == CMD_SIMPLE ? run_words(c->words, info) : run_group(c, info);
+
+		int ok = info->exit_status == 0;
+		run = c->join == JOIN_AND ? ok : c->join == JOIN_OR ? !ok : 1;
+	}
+
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : run_line(..)
+// parameters : char* words[]
+//              struct shell_info *info
+// description: Parses a line of groups or commands joined by ; && ||
+//              in one pass, into the command arena, and runs it
+//              Returns 0 if it ran exit
+// example    : cd build && make || echo build failed
+// --------------------------------------------------------------- //
+int run_line(char* words[], struct shell_info *info) {
+	const char* error;
+	struct command* list = parse_commands(words, &cmd_arena, &error);
+
+	if (!list) {
+		printf("syntax error near %s \n", error ? error : words[0]);
+		fflush(stdout);
+		info->exit_status = 2 << 8;
+		return 1;
+	}
+
+	return run_list(list, info);
+}
+
+
+// ------------------ Signal Functions ------------------ //
+
+// --------------------------------------------------------------- //
+// function   : handle_SIG(..)
+// parameters : in signo
+// description: Custom handler for SIGINT / ^C
+//              Children running as a foreground process terminates itself
+// reference  : How can a process kill itself - https://stackoverflow.com/a/7851269/10895933
+// --------------------------------------------------------------- //
+void handle_SIG(int signo) {
+	// stop_background is a global variable (only used for custom sig handler)
+	if (stop_background == 0) {
+
+		// Print "No more background" message
+		char* msg = "Entering foreground-only mode (& is now ignored) \n";
+		write(STDOUT_FILENO, msg, 50);
+		fflush(stdout);
+
+		stop_background = 1;  // set stop_background flag on
+
+	}	else {
+		// Print "Background is back on" message
+		char* msg = "Exiting foreground-only mode \n";
+		write(STDOUT_FILENO, msg, 30);
+		fflush(stdout);
+
+		stop_background = 0;  // Set stop_background flag off
+	}
+}
+
+
+void custom_SIG() {
+	struct sigaction SIG_IG = { 0 };  // Ignores ^C
+	SIG_IG.sa_handler = SIG_IGN;	  // This is reinstated for children
+	sigfillset(&SIG_IG.sa_mask);
+	SIG_IG.sa_flags = SA_RESTART;
+	sigaction(SIGINT, &SIG_IG, NULL);
+}
+
+void custom_SIGTSTP() {
+	struct sigaction SIGINT_action = { 0 };  // Init struct to be empty
+	SIGINT_action.sa_handler = handle_SIG;  // Register as the signal handler
+	sigfillset(&SIGINT_action.sa_mask);  // Block all catchable signals while running
+	SIGINT_action.sa_flags = SA_RESTART;  // Clear error caused by signal
+	sigaction(SIGTSTP, &SIGINT_action, NULL);  // Install our signal handler
+}
+
+void custom_IG() {
+	struct sigaction SIG_IG = { 0 };
+	SIG_IG.sa_handler = SIG_IGN;
+	sigfillset(&SIG_IG.sa_mask);
+	SIG_IG.sa_flags = SA_RESTART;
+	sigaction(SIGTSTP, &SIG_IG, NULL);
+}
+
+// ------------------ Shell Main Function ------------------ //
+
+// --------------------------------------------------------------- //
+// function   : is_builtin(..)
+// parameters : char* args[]
+// description: Returns 1 if the command is one of the shell's own
+//              builtins (plugins do real work, so they don't count,
+//              and neither do groups or lists, which may run anything)
+// --------------------------------------------------------------- //
+int is_builtin(char* args[]) {
+	struct builtin* b = find_builtin(args[0]);
+	return b && b->kind == BUILTIN_SHELL && b->fn != builtin_group && !is_list(args);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : run_file(..)
+// parameters : const char* path
+//              struct shell_info *info
+// description: Runs a script in the current shell, for the startup
+//              file and source. It is read through its compiled
+//              snapshot, so once cached its lines are used straight
+//              from the mapping instead of being parsed again. Each
+//              line's memory is released back to where the arena was,
+//              leaving the command that sourced the file intact
+//              Leaves the last exit status in info
+//              Returns 0 if the file ran exit, -1 if it can't be read
+// --------------------------------------------------------------- //
+int run_file(const char* path, struct shell_info *info) {
+	struct snapshot snap;
+	struct shell_info line_info;
+	struct arena_mark mark;
+	struct arg_vec args;
+	struct cmd_desc* line;
+	int status = 1;
+
+	if (snapshot_open(&snap, path) != 0)
+		return -1;
+
+	arena_mark(&cmd_arena, &mark);
+
+	while (status && (line = snapshot_next(&snap))) {
+		init_shell_info(&line_info);
+		line_info.exit_status = info->exit_status;  // For status
+		arg_vec_init(&args, &cmd_arena);
+
+		parse_line(line, &line_info, &args);
+		status = execute_cmd(args.items, &line_info);
+		info->exit_status = line_info.exit_status;
+
+		free(line);
+		arena_release(&cmd_arena, &mark);
+	}
+
+	snapshot_close(&snap);
+
+	return status;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_self_script(..)
+// parameters : char* args[]
+//              struct exec_target *target
+// description: Returns 1 if the command would exec this smallsh on a
+//              script, with only options sub_shell() can take. The
+//              script must be readable here, so the copy never has to
+//              fail with exit() (see sub_shell). --journal and
+//              --resume take the exec path, opening the journal can
+//              exit()
+// example    : smallsh --quiet build.sh
+// --------------------------------------------------------------- //
+int is_self_script(char* args[], struct exec_target *target) {
+	static struct stat self;
+	static int self_known = 0;
+	struct stat st;
+	char* script = NULL;
+	char* base = strrchr(args[0], '/');
+
+	base = base ? base + 1 : args[0];
+	if (strncmp(base, "smallsh", 7) != 0)  // Cheap test before any stat
+		return 0;
+
+	for (int i = 1; args[i]; i++) {
+		if (strcmp(args[i], "--rc") == 0 || strcmp(args[i], "--lookahead") == 0) {
+			if (!args[++i])
+				return 0;
+		} else if (strcmp(args[i], "--quiet") == 0 || strcmp(args[i], "--norc") == 0 ||
+		           strcmp(args[i], "--no-cache") == 0 || strcmp(args[i], "--pipeline") == 0 ||
+		           strcmp(args[i], "--redirect-beneath") == 0) {
+			continue;
+		} else if (args[i][0] == '-' && args[i][1] == '-') {
+			return 0;  // --journal, --version, --startup-bench and the like
+		} else if (script) {
+			return 0;
+		} else {
+			script = args[i];
+		}
+	}
+
+	if (!script || access(script, R_OK) == -1)
+		return 0;
+
+	if (!self_known) {
+		if (stat("/proc/self/exe", &self) == -1)
+			return 0;
+		self_known = 1;
+	}
+
+	if (target->fd != -1 ? fstat(target->fd, &st) == -1
+	                     : !target->path || stat(target->path, &st) == -1)
+		return 0;
+
+	return st.st_dev == self.st_dev && st.st_ino == self.st_ino;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : detach_script(..)
+// parameters : int token
+// description: In a forked copy of the shell, drops the parent's
+//              script, lookahead, journal and jobs, so the copy can't
+//              read ahead in the script or write to the journal
+//              token is the jobserver token the copy runs on, if any
+// --------------------------------------------------------------- //
+void detach_script(int token) {
+	reader_detach();
+	lookahead_init(0);
+	journal_detach();
+	jobs_clear();  // Not this copy's children
+	jobserver_detach(token);
+	sched_detach();
+	mux_detach();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sub_shell(..)
+// parameters : char* args[]
+//              int token
+// description: Runs smallsh args in a forked copy of this shell
+//              instead of exec'ing a new one, skipping exec, dynamic
+//              linking and startup. The copy forgets the parent's
+//              script, journal, aliases, functions and pushd stack,
+//              then runs like a freshly started shell. cwd and
+//              variables are its own, being a separate process
+//              Returns the status for _exit(). Nothing here may call
+//              exit(): stdio would move the parent's script offset
+// --------------------------------------------------------------- //
+int sub_shell(char* args[], int token) {
+	struct shell_options opts;
+	int argc = 0;
+
+	while (args[argc])
+		argc++;
+
+	parse_options(argc, args, &opts);  // Checked by is_self_script()
+
+	detach_script(token);
+	clear_builtins();
+	stop_background = 0;
+	in_group = 0;  // A shell of its own, whatever group started it
+
+	small_shell(&opts);
+
+	fflush(stdout);
+	return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : small_shell(..)
+// parameters : struct shell_options *opts
+// description: Controls the flow of the small shell
+//              Gets user input as string
+//              Parses string into command
+//              Executes command
+//              Loops until user gives exit command or input ends
+//              When resuming from a journal, commands a previous run
+//              completed are skipped. Builtins are still replayed so
+//              state like the working directory is rebuilt
+// --------------------------------------------------------------- //
+void small_shell(struct shell_options *opts) {
+	struct shell_info info;
+	int status = 1;
+	struct arg_vec args;
+	FILE* in = stdin;
+	long index = 0;  // Line index of the command in the script
+
+	if (opts->script) {
+		if (!opts->cache || reader_init_compiled(opts->script) == -1) {
+			in = fopen(opts->script, "re");
+
+			if (!in) {
+				perror(opts->script);
+				exit(1);
+			}
+
+			reader_init(in, opts->pipeline);
+		}
+
+		lookahead_init(opts->lookahead);
+	}
+
+	if (opts->journal)
+		journal_open(opts->journal, opts->script, opts->resume);
+
+	arena_init(&cmd_arena);
+	dirs_init(opts->beneath);
+	jobserver_init(opts->jobs);
+	sched_init(launch_queued);
+
+	if (opts->pressure && pressure_init(opts->pressure) == -1)
+		exit(2);
+
+	if (opts->spawn_rate && ratelimit_init(opts->spawn_rate) == -1)
+		exit(2);
+
+	init_builtins();
+
+	custom_SIG();  // Set custom signal handlers
+	custom_SIGTSTP();
+
+	if (opts->init || getpid() == 1)  // Container entrypoint
+		reaper_init();
+
+	if (opts->prefix_output)
+		mux_init();
+
+	if (opts->rc) {  // A missing startup file is fine
+		init_shell_info(&info);
+		status = run_file(opts->rc, &info) != 0;
+	}
+
+	if (!opts->quiet)  // Displays title of program
+		write(STDOUT_FILENO, "smallsh \n", 9);  // Nothing buffered yet, skip stdio
+
+	if (opts->probe)  // Launched by --startup-bench, first prompt reached
+		startup_probe(opts->probe);
+
+	while (status) {
+		init_shell_info(&info);  // Initialize shell info to 0
+		arg_vec_init(&args, &cmd_arena);
+
+		// Gets user string input, or the next script line
+		struct cmd_desc* line = opts->script ? lookahead_next() : get_input(in, 1);
+
+		if (!line)  // End of input
+			break;
+
+		index++;
+
+		parse_line(line, &info, &args);  // Parses input into arguments
+
+		if (journal_completed(index, &info.exit_status) && !is_builtin(args.items)) {
+			free_memory(line);  // Done by a previous run
+			continue;
+		}
+
+		status = execute_cmd(args.items, &info);  // Executes passed in command
+
+		journal_record(index, info.exit_status);
+
+		free_memory(line);
+
+		if (reaper_terminated())  // SIGTERM or SIGHUP, passed on to the command
+			break;
+	}
+
+	if (!reaper_terminated())
+		sched_finish(reap_jobs);  // Start jobs still queued for a token
+
+	mux_finish();  // Last lines of & jobs
+
+	arena_free(&cmd_arena);
+
+	journal_close();
+
+	reader_stop();  // Reader thread and snapshot are done with the script
+
+	if (in != stdin)
+		fclose(in);
+}
+
+
+// ------------------ Main Function ------------------ //
+int main(int argc, char* argv[]) {
+	struct shell_options opts;
+
+	parse_options(argc, argv, &opts);
+
+	if (opts.bench) {
+		startup_bench(argv[0], opts.bench);
+		return 0;
+	}
+
+	small_shell(&opts);
+
+	return reaper_terminated() ? 128 + reaper_terminated() : 0;
+}
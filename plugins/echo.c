@@ -0,0 +1,58 @@
+// echo.c
+//
+// Example smallsh plugin: an in-process echo, so scripts that echo
+// thousands of lines don't fork for each one.
+//
+//   make plugins
+//   enable -f ./plugins/echo.so
+
+#include <string.h>
+#include <unistd.h>
+#include "src/smallsh_plugin.h"
+
+
+// --------------------------------------------------------------- //
+// function   : plugin_echo(..)
+// parameters : int argc
+//              char* argv[]
+//              int fds[3]
+//              char* envp[]
+// description: Writes its arguments separated by spaces to fds[1]
+// --------------------------------------------------------------- //
+static int plugin_echo(int argc, char* argv[], int fds[3], char* envp[]) {
+  char buf[4096];
+  size_t len = 0;
+
+  for (int i = 1; i < argc; i++) {
+    size_t n = strlen(argv[i]);
+
+    if (len + n + 1 > sizeof(buf)) {  // Flush when the buffer fills up
+      if (write(fds[1], buf, len) == -1)
+        return 1;
+      len = 0;
+    }
+
+    if (n + 1 > sizeof(buf)) {  // Too long to buffer
+      if (write(fds[1], argv[i], n) == -1)
+        return 1;
+    } else {
+      memcpy(buf + len, argv[i], n);
+      len += n;
+    }
+
+    buf[len++] = (i + 1 < argc) ? ' ' : '\n';
+  }
+
+  if (argc < 2)
+    buf[len++] = '\n';
+
+  return write(fds[1], buf, len) == -1;
+}
+
+
+int smallsh_plugin_init(struct smallsh_plugin_api *api) {
+  if (api->abi != SMALLSH_PLUGIN_ABI)
+    return -1;
+
+  return api->register_builtin("echo", plugin_echo);
+}
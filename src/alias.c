@@ -0,0 +1,191 @@
+// alias.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/alias.h"
+
+
+// --------------------------------------------------------------- //
+// function   : template_new(..)
+// parameters : char* tokens[]
+//              int n
+// description: Copies n tokens into a new template
+// --------------------------------------------------------------- //
+static struct template* template_new(char* tokens[], int n) {
+  struct template* t = malloc(sizeof(struct template));
+
+  t->tokens = malloc((n + 1) * sizeof(char*));
+  t->len = n;
+
+  for (int i = 0; i < n; i++)
+    t->tokens[i] = strdup(tokens[i]);
+  t->tokens[n] = NULL;
+
+  return t;
+}
+
+
+static void template_free(struct template* t) {
+  for (int i = 0; i < t->len; i++)
+    free(t->tokens[i]);
+  free(t->tokens);
+  free(t);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : define(..)
+// parameters : const char* name
+//              int kind
+//              builtin_fn fn
+//              char* tokens[]
+//              int n
+// description: Stores a template under name, replacing any alias or
+//              function of the same name. Returns 0 on success
+// --------------------------------------------------------------- //
+static int define(const char* name, int kind, builtin_fn fn, char* tokens[], int n) {
+  struct builtin* old = find_builtin(name);
+  struct template* t = template_new(tokens, n);
+
+  if (old && (old->kind == BUILTIN_ALIAS || old->kind == BUILTIN_FUNCTION))
+    template_free(old->data);
+
+  if (define_builtin(name, kind, fn, t) != 0) {
+    template_free(t);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : alias_define(..)
+// parameters : const char* name
+//              char* tokens[]
+//              int n
+// description: Defines alias name to expand to n tokens
+// example    : alias ll=ls -l  ->  alias_define("ll", {"ls", "-l"}, 2)
+// --------------------------------------------------------------- //
+int alias_define(const char* name, char* tokens[], int n) {
+  return define(name, BUILTIN_ALIAS, NULL, tokens, n);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : function_define(..)
+// parameters : const char* name
+//              char* tokens[]
+//              int n
+//              builtin_fn call
+// description: Defines function name with a body of n tokens. call
+//              runs the body when the function is invoked
+// --------------------------------------------------------------- //
+int function_define(const char* name, char* tokens[], int n, builtin_fn call) {
+  return define(name, BUILTIN_FUNCTION, call, tokens, n);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : alias_remove(..)
+// parameters : const char* name
+// description: Removes alias or function name. Returns 0 on success
+// --------------------------------------------------------------- //
+int alias_remove(const char* name) {
+  struct builtin* b = find_builtin(name);
+
+  if (!b || (b->kind != BUILTIN_ALIAS && b->kind != BUILTIN_FUNCTION))
+    return -1;
+
+  template_free(undefine_builtin(name));
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : print_entry(..)
+// parameters : struct builtin* b
+// description: Prints an alias or function the way it is defined
+// --------------------------------------------------------------- //
+static void print_entry(struct builtin* b) {
+  struct template* t = b->data;
+
+  if (b->kind == BUILTIN_ALIAS)
+    printf("alias %s=", b->name);
+  else
+    printf("function %s {", b->name);
+
+  for (int i = 0; i < t->len; i++)
+    printf(i || b->kind == BUILTIN_FUNCTION ? " %s" : "%s", t->tokens[i]);
+
+  printf(b->kind == BUILTIN_ALIAS ? "\n" : " }\n");
+}
+
+
+// --------------------------------------------------------------- //
+// function   : alias_print(..)
+// parameters : const char* name
+// description: Prints one alias or function
+// --------------------------------------------------------------- //
+void alias_print(const char* name) {
+  struct builtin* b = find_builtin(name);
+
+  if (b && (b->kind == BUILTIN_ALIAS || b->kind == BUILTIN_FUNCTION))
+    print_entry(b);
+  else
+    printf("alias: %s not found\n", name);
+
+  fflush(stdout);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : alias_list()
+// parameters : none
+// description: Prints every alias, then every function
+// --------------------------------------------------------------- //
+void alias_list() {
+  for_each_builtin(BUILTIN_ALIAS, print_entry);
+  for_each_builtin(BUILTIN_FUNCTION, print_entry);
+  fflush(stdout);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : template_splice(..)
+// parameters : struct arg_vec *out
+//              struct template *t
+//              char* args[]
+// description: Appends copies of a function body's tokens to out,
+//              replacing $0-$9 with args, $@ with every argument and
+//              $# with the number of arguments
+// --------------------------------------------------------------- //
+void template_splice(struct arg_vec *out, struct template *t, char* args[]) {
+  int argc = 0;
+  char count[16];
+
+  while (args[argc])
+    argc++;
+
+  for (int i = 0; i < t->len; i++) {
+    char* tok = t->tokens[i];
+
+    if (tok[0] == '$' && tok[1] >= '0' && tok[1] <= '9' && !tok[2]) {
+      int n = tok[1] - '0';
+      if (n < argc)
+        arg_vec_push_copy(out, args[n]);  // Unset positionals vanish
+
+    } else if (strcmp(tok, "$@") == 0) {
+      for (int a = 1; a < argc; a++)
+        arg_vec_push_copy(out, args[a]);
+
+    } else if (strcmp(tok, "$#") == 0) {
+      snprintf(count, sizeof(count), "%d", argc - 1);
+      arg_vec_push_copy(out, count);
+
+    } else {
+      arg_vec_push_copy(out, tok);
+    }
+  }
+}
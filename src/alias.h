@@ -0,0 +1,28 @@
+// alias.h
+
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include "src/arg_vec.h"
+#include "src/builtins.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct template
+// description: Pre-tokenized body of an alias or function. Invoking
+//              one splices these tokens into the command's arguments
+//              instead of parsing the body text again
+// --------------------------------------------------------------- //
+struct template {
+  char** tokens;  // NULL terminated
+  int    len;
+};
+
+int  alias_define(const char* name, char* tokens[], int n);
+int  function_define(const char* name, char* tokens[], int n, builtin_fn call);
+int  alias_remove(const char* name);
+void alias_print(const char* name);
+void alias_list();
+void template_splice(struct arg_vec *out, struct template *t, char* args[]);
+
+#endif
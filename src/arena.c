@@ -0,0 +1,123 @@
+// arena.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/arena.h"
+
+#define ARENA_BLOCK  (64 * 1024)  // Enough for any ordinary command line
+
+
+// --------------------------------------------------------------- //
+// function   : new_block(..)
+// parameters : size_t size
+// description: Allocates a block with room for size bytes
+// --------------------------------------------------------------- //
+static struct arena_block* new_block(size_t size) {
+  struct arena_block* b = malloc(sizeof(struct arena_block) + size);
+
+  if (!b) {
+    perror("malloc");
+    exit(1);
+  }
+
+  b->next = NULL;
+  b->size = size;
+  b->used = 0;
+  return b;
+}
+
+
+void arena_init(struct arena *a) {
+  a->first = a->head = new_block(ARENA_BLOCK);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arena_alloc(..)
+// parameters : struct arena *a
+//              size_t size
+// description: Returns size bytes aligned for any type. Requests the
+//              current block can't hold start a new block at least
+//              twice as big as the last, so growth is amortized
+// --------------------------------------------------------------- //
+void* arena_alloc(struct arena *a, size_t size) {
+  struct arena_block* b = a->head;
+  size_t start = (b->used + 15) & ~(size_t) 15;
+
+  if (start + size > b->size) {
+    size_t next = b->size * 2;
+    while (next < size)
+      next *= 2;
+
+    b->next = new_block(next);
+    a->head = b = b->next;
+    start = 0;
+  }
+
+  b->used = start + size;
+  return b->data + start;
+}
+
+
+char* arena_strdup(struct arena *a, const char* s) {
+  size_t len = strlen(s) + 1;
+  return memcpy(arena_alloc(a, len), s, len);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arena_reset(..)
+// parameters : struct arena *a
+// description: Releases everything allocated. The first block is
+//              kept for the next command; any overflow blocks from an
+//              unusually large one are freed
+// --------------------------------------------------------------- //
+void arena_reset(struct arena *a) {
+  struct arena_block* b = a->first->next;
+
+  while (b) {
+    struct arena_block* next = b->next;
+    free(b);
+    b = next;
+  }
+
+  a->first->next = NULL;
+  a->first->used = 0;
+  a->head = a->first;
+}
+
+
+void arena_mark(struct arena *a, struct arena_mark *m) {
+  m->block = a->head;
+  m->used = a->head->used;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arena_release(..)
+// parameters : struct arena *a
+//              struct arena_mark *m
+// description: Releases everything allocated since arena_mark() set
+//              m. Blocks started after it are freed
+// --------------------------------------------------------------- //
+void arena_release(struct arena *a, struct arena_mark *m) {
+  struct arena_block* b = m->block->next;
+
+  while (b) {
+    struct arena_block* next = b->next;
+    free(b);
+    b = next;
+  }
+
+  m->block->next = NULL;
+  m->block->used = m->used;
+  a->head = m->block;
+}
+
+
+void arena_free(struct arena *a) {
+  arena_reset(a);
+  free(a->first);
+  a->first = a->head = NULL;
+}
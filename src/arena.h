@@ -0,0 +1,42 @@
+// arena.h
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+
+// --------------------------------------------------------------- //
+// structure  : struct arena
+// description: Bump allocator for memory that lives exactly as long
+//              as one command. Everything is released at once with
+//              arena_reset() instead of freeing piece by piece
+// --------------------------------------------------------------- //
+struct arena_block {
+  struct arena_block* next;
+  size_t size;
+  size_t used;
+  char   data[];
+};
+
+struct arena {
+  struct arena_block* head;  // Block being allocated from
+  struct arena_block* first; // Kept across resets
+};
+
+// Position to roll back to, so a command run inside another one
+// (a sourced script line) can release its memory but not the outer's
+struct arena_mark {
+  struct arena_block* block;
+  size_t used;
+};
+
+void  arena_init(struct arena *a);
+void* arena_alloc(struct arena *a, size_t size);
+char* arena_strdup(struct arena *a, const char* s);
+void  arena_reset(struct arena *a);
+void  arena_mark(struct arena *a, struct arena_mark *m);
+void  arena_release(struct arena *a, struct arena_mark *m);
+void  arena_free(struct arena *a);
+
+#endif
@@ -0,0 +1,48 @@
+// arg_max.c
+
+#include <string.h>
+#include <unistd.h>
+#include "src/arg_max.h"
+
+#define ARG_HEADROOM 2048  // Same slack POSIX asks xargs to leave
+
+extern char** environ;
+
+
+long exec_arg_size(const char* arg) {
+  return strlen(arg) + 1 + sizeof(char*);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : exec_args_size(..)
+// parameters : char* args[]
+// description: Returns the bytes args take up against ARG_MAX
+// --------------------------------------------------------------- //
+long exec_args_size(char* args[]) {
+  long size = sizeof(char*);  // NULL terminator
+
+  for (int i = 0; args[i]; i++)
+    size += exec_arg_size(args[i]);
+
+  return size;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : exec_arg_limit()
+// parameters : none
+// description: Returns how many bytes of arguments an exec can take
+//              right now: ARG_MAX less the environment and headroom
+// --------------------------------------------------------------- //
+long exec_arg_limit() {
+  static long arg_max = 0;
+
+  if (!arg_max) {
+    arg_max = sysconf(_SC_ARG_MAX);
+    if (arg_max <= 0)
+      arg_max = 128 * 1024;  // Old fixed Linux limit
+  }
+
+  return arg_max - exec_args_size(environ) - ARG_HEADROOM;
+}
@@ -0,0 +1,16 @@
+// arg_max.h
+
+#ifndef ARG_MAX_H
+#define ARG_MAX_H
+
+
+// --------------------------------------------------------------- //
+// description: Size limits on the arguments passed to exec. The
+//              kernel counts each string plus its pointer, for both
+//              argv and the environment, against ARG_MAX
+// --------------------------------------------------------------- //
+long exec_arg_limit();
+long exec_arg_size(const char* arg);
+long exec_args_size(char* args[]);
+
+#endif
@@ -0,0 +1,119 @@
+// arg_vec.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/arg_vec.h"
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_alloc(..)
+// parameters : struct arg_vec *v
+//              int cap
+// description: Returns storage for cap pointers from the vector's
+//              arena, or the heap if it has none
+// --------------------------------------------------------------- //
+static char** arg_vec_alloc(struct arg_vec *v, int cap) {
+  char** items = v->arena ? arena_alloc(v->arena, cap * sizeof(char*))
+                          : malloc(cap * sizeof(char*));
+
+  if (!items) {
+    perror("malloc");
+    exit(1);
+  }
+
+  return items;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_init(..)
+// parameters : struct arg_vec *v
+//              struct arena *arena
+// description: Initializes an empty vector allocating from arena
+//              (which may be NULL)
+// --------------------------------------------------------------- //
+void arg_vec_init(struct arg_vec *v, struct arena *arena) {
+  v->arena = arena;
+  v->cap = 16;
+  v->len = 0;
+  v->items = arg_vec_alloc(v, v->cap);
+  v->items[0] = NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_push(..)
+// parameters : struct arg_vec *v
+//              char* item
+// description: Appends item, doubling the storage when it is full
+// --------------------------------------------------------------- //
+void arg_vec_push(struct arg_vec *v, char* item) {
+  if (v->len + 1 >= v->cap) {  // Keep room for the NULL terminator
+    char** items = arg_vec_alloc(v, v->cap * 2);
+
+    memcpy(items, v->items, v->len * sizeof(char*));
+    if (!v->arena)
+      free(v->items);  // Arena storage goes when the arena is reset
+
+    v->items = items;
+    v->cap *= 2;
+  }
+
+  v->items[v->len++] = item;
+  v->items[v->len] = NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_push_copy(..)
+// parameters : struct arg_vec *v
+//              const char* item
+// description: Appends a copy of item owned by the vector
+// --------------------------------------------------------------- //
+void arg_vec_push_copy(struct arg_vec *v, const char* item) {
+  arg_vec_push(v, v->arena ? arena_strdup(v->arena, item) : strdup(item));
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_reset(..)
+// parameters : struct arg_vec *v
+// description: Empties the vector without freeing the items, for
+//              vectors that only borrow their strings
+// --------------------------------------------------------------- //
+void arg_vec_reset(struct arg_vec *v) {
+  v->len = 0;
+  v->items[0] = NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_clear(..)
+// parameters : struct arg_vec *v
+// description: Frees each heap item and empties the vector
+// --------------------------------------------------------------- //
+void arg_vec_clear(struct arg_vec *v) {
+  if (!v->arena) {
+    for (int i = 0; i < v->len; i++)
+      free(v->items[i]);
+  }
+
+  arg_vec_reset(v);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : arg_vec_free(..)
+// parameters : struct arg_vec *v
+// description: Frees the items and the vector's heap storage
+// --------------------------------------------------------------- //
+void arg_vec_free(struct arg_vec *v) {
+  arg_vec_clear(v);
+
+  if (!v->arena)
+    free(v->items);
+
+  v->items = NULL;
+  v->cap = 0;
+}
@@ -0,0 +1,31 @@
+// arg_vec.h
+
+#ifndef ARG_VEC_H
+#define ARG_VEC_H
+
+#include "src/arena.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct arg_vec
+// description: Growable array of strings. items is always NULL
+//              terminated so it can be passed straight to execvp
+//              With an arena, the array and copied strings live in it
+//              and are released with the arena; otherwise they are
+//              malloc'd and owned by the vector
+// --------------------------------------------------------------- //
+struct arg_vec {
+  char** items;
+  int    len;
+  int    cap;
+  struct arena* arena;
+};
+
+void arg_vec_init(struct arg_vec *v, struct arena *arena);
+void arg_vec_push(struct arg_vec *v, char* item);
+void arg_vec_push_copy(struct arg_vec *v, const char* item);
+void arg_vec_reset(struct arg_vec *v);
+void arg_vec_clear(struct arg_vec *v);
+void arg_vec_free(struct arg_vec *v);
+
+#endif
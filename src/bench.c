@@ -0,0 +1,113 @@
+// bench.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "src/bench.h"
+
+
+// --------------------------------------------------------------- //
+// function   : now_ns()
+// parameters : none
+// description: Returns CLOCK_MONOTONIC in nanoseconds. The clock is
+//              system wide, so readings survive exec
+// --------------------------------------------------------------- //
+static long long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+static int cmp_ll(const void* a, const void* b) {
+  long long x = *(const long long*) a, y = *(const long long*) b;
+  return (x > y) - (x < y);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : startup_bench(..)
+// parameters : char* self
+//              int runs
+// description: Launches smallsh --quiet runs times. Each child takes
+//              a timestamp right before execv and passes it along
+//              with a pipe; the new shell writes back the elapsed time
+//              when it reaches its first prompt (see startup_probe)
+// --------------------------------------------------------------- //
+void startup_bench(char* self, int runs) {
+  long long* samples = malloc(runs * sizeof(long long));
+  long long total = 0;
+  int n = 0;
+  int fds[2];
+
+  if (!samples || pipe(fds) == -1) {
+    perror("startup-bench");
+    exit(1);
+  }
+
+  for (int i = 0; i < runs; i++) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+      perror("fork() \n");
+      exit(1);
+
+    } else if (pid == 0) {
+      char probe[64];
+      char* argv[] = { self, "--quiet", "--startup-probe", probe, NULL };
+
+      close(fds[0]);
+      snprintf(probe, sizeof(probe), "%d:%lld", fds[1], now_ns());
+      execv("/proc/self/exe", argv);
+      perror("execv");
+      _exit(2);
+    }
+
+    long long elapsed;
+    if (read(fds[0], &elapsed, sizeof(elapsed)) == sizeof(elapsed)) {
+      samples[n++] = elapsed;
+      total += elapsed;
+    }
+
+    waitpid(pid, NULL, 0);
+  }
+
+  if (n == 0) {
+    fprintf(stderr, "startup-bench: no samples\n");
+    exit(1);
+  }
+
+  qsort(samples, n, sizeof(long long), cmp_ll);
+
+  printf("startup (exec to first prompt), %d runs\n", n);
+  printf("  min    %8.1f us\n", samples[0] / 1000.0);
+  printf("  median %8.1f us\n", samples[n / 2] / 1000.0);
+  printf("  p99    %8.1f us\n", samples[(n * 99) / 100] / 1000.0);
+  printf("  mean   %8.1f us\n", total / 1000.0 / n);
+  printf("  max    %8.1f us\n", samples[n - 1] / 1000.0);
+  fflush(stdout);
+
+  free(samples);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : startup_probe(..)
+// parameters : char* probe
+// description: Called where the shell would show its first prompt
+//              when launched by startup_bench. Reports the time since
+//              the parent's exec and exits
+// --------------------------------------------------------------- //
+void startup_probe(char* probe) {
+  int fd;
+  long long start;
+
+  if (sscanf(probe, "%d:%lld", &fd, &start) != 2)
+    _exit(2);
+
+  long long elapsed = now_ns() - start;
+  write(fd, &elapsed, sizeof(elapsed));
+  _exit(0);
+}
@@ -0,0 +1,14 @@
+// bench.h
+
+#ifndef BENCH_H
+#define BENCH_H
+
+
+// --------------------------------------------------------------- //
+// description: --startup-bench measures how long smallsh takes from
+//              exec to being ready for its first command
+// --------------------------------------------------------------- //
+void startup_bench(char* self, int runs);
+void startup_probe(char* probe);
+
+#endif
@@ -0,0 +1,398 @@
+// builtins.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include "src/builtins.h"
+#include "src/fds.h"
+
+extern char** environ;
+
+// The shell's own builtins, indexed by BUILTIN_HASH
+static const struct builtin* core = NULL;
+
+// Everything else: open addressing table, kept at most half full
+static struct builtin* table = NULL;
+static unsigned table_size = 0;
+static unsigned table_used = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : core_slot(..)
+// parameters : const char* name
+// description: Returns the perfect hash slot name would occupy in the
+//              table of shell builtins
+// --------------------------------------------------------------- //
+static unsigned core_slot(const char* name) {
+  size_t len = strlen(name);
+  return len ? BUILTIN_HASH(len, name[0], name[len - 1]) : 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : find_core(..)
+// parameters : const char* name
+// description: Returns the shell builtin called name, or NULL
+// --------------------------------------------------------------- //
+static const struct builtin* find_core(const char* name) {
+  if (!core)
+    return NULL;
+
+  const struct builtin* b = &core[core_slot(name)];
+  return (b->name && strcmp(b->name, name) == 0) ? b : NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : set_core_builtins(..)
+// parameters : const struct builtin* table
+// description: Installs the table of shell builtins. Collisions are
+//              caught when it is compiled; this catches an entry whose
+//              BUILTIN_HASH arguments don't match its name
+// --------------------------------------------------------------- //
+void set_core_builtins(const struct builtin* builtins) {
+  for (unsigned i = 0; i < BUILTIN_SLOTS; i++) {
+    if (builtins[i].name && core_slot(builtins[i].name) != i) {
+      fprintf(stderr, "builtin %s is in slot %u, expected %u\n",
+              builtins[i].name, i, core_slot(builtins[i].name));
+      abort();
+    }
+  }
+
+  core = builtins;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : hash_name(..)
+// parameters : const char* name
+// description: FNV-1a hash of a builtin name
+// --------------------------------------------------------------- //
+static unsigned hash_name(const char* name) {
+  unsigned h = 2166136261u;
+  while (*name) {
+    h ^= (unsigned char) *name++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : slot_for(..)
+// parameters : const char* name
+// description: Returns the slot holding name, or the empty slot where
+//              it would be inserted
+// --------------------------------------------------------------- //
+static struct builtin* slot_for(const char* name) {
+  unsigned i = hash_name(name) & (table_size - 1);
+
+  while (table[i].name && strcmp(table[i].name, name) != 0)
+    i = (i + 1) & (table_size - 1);
+
+  return &table[i];
+}
+
+
+// --------------------------------------------------------------- //
+// function   : grow_table()
+// parameters : none
+// description: Doubles the table and rehashes existing entries
+// --------------------------------------------------------------- //
+static void grow_table() {
+  struct builtin* old = table;
+  unsigned old_size = table_size;
+
+  table_size = table_size ? table_size * 2 : 16;
+  table = calloc(table_size, sizeof(struct builtin));
+
+  for (unsigned i = 0; i < old_size; i++)
+    if (old[i].name)
+      *slot_for(old[i].name) = old[i];
+
+  free(old);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : add_entry(..)
+// parameters : const char* name
+//              int kind
+//              builtin_fn fn
+//              smallsh_builtin plugin
+//              void* data
+// description: Adds or replaces an entry. Shell builtins can't be
+//              replaced, since lookups never get past them
+//              Returns 0 on success
+// --------------------------------------------------------------- //
+static int add_entry(const char* name, int kind, builtin_fn fn,
+                     smallsh_builtin plugin, void* data) {
+  if (!name || !*name)
+    return -1;
+
+  if (core && find_core(name)) {
+    fprintf(stderr, "%s: is a shell builtin\n", name);
+    return -1;
+  }
+
+  if ((table_used + 1) * 2 > table_size)
+    grow_table();
+
+  struct builtin* b = slot_for(name);
+
+  if (!b->name) {
+    b->name = strdup(name);
+    table_used++;
+  }
+
+  b->kind = kind;
+  b->fn = fn;
+  b->plugin = plugin;
+  b->data = data;
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : define_builtin(..)
+// parameters : const char* name
+//              int kind
+//              builtin_fn fn
+//              void* data
+// description: Defines a name resolved by the shell, such as a user
+//              function or alias. Returns 0 on success
+// --------------------------------------------------------------- //
+int define_builtin(const char* name, int kind, builtin_fn fn, void* data) {
+  return add_entry(name, kind, fn, NULL, data);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : undefine_builtin(..)
+// parameters : const char* name
+// description: Removes a name added with define_builtin() and returns
+//              its data. Later entries of the probe run are shifted
+//              back so lookups never need tombstones
+// --------------------------------------------------------------- //
+void* undefine_builtin(const char* name) {
+  if (!table_used)
+    return NULL;
+
+  struct builtin* b = slot_for(name);
+  if (!b->name)
+    return NULL;
+
+  void* data = b->data;
+  unsigned mask = table_size - 1;
+  unsigned hole = b - table;
+
+  free(b->name);
+  memset(b, 0, sizeof(*b));
+  table_used--;
+
+  for (unsigned i = (hole + 1) & mask; table[i].name; i = (i + 1) & mask) {
+    unsigned home = hash_name(table[i].name) & mask;
+
+    // Move the entry into the hole unless its home lies in (hole, i]
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      table[hole] = table[i];
+      memset(&table[i], 0, sizeof(table[i]));
+      hole = i;
+    }
+  }
+
+  return data;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : for_each_builtin(..)
+// parameters : int kind
+//              void (*fn)(struct builtin* b)
+// description: Calls fn for every defined name of the given kind
+// --------------------------------------------------------------- //
+void for_each_builtin(int kind, void (*fn)(struct builtin* b)) {
+  for (unsigned i = 0; i < table_size; i++) {
+    if (table[i].name && table[i].kind == kind)
+      fn(&table[i]);
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : clear_builtins()
+// parameters : none
+// description: Drops every plugin, function and alias, as if the
+//              shell had just started. Their data is not freed, since
+//              its owners aren't known here; this is for a forked
+//              copy of the shell about to run as a new one
+// --------------------------------------------------------------- //
+void clear_builtins() {
+  if (!table)
+    return;
+
+  for (unsigned i = 0; i < table_size; i++)
+    free(table[i].name);
+
+  memset(table, 0, table_size * sizeof(struct builtin));
+  table_used = 0;
+}
+
+
+// Handed to plugins through struct smallsh_plugin_api
+static int register_plugin_builtin(const char* name, smallsh_builtin fn) {
+  return fn ? add_entry(name, BUILTIN_PLUGIN, NULL, fn, NULL) : -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : find_builtin(..)
+// parameters : const char* name
+// description: Returns the builtin called name, or NULL
+// --------------------------------------------------------------- //
+struct builtin* find_builtin(const char* name) {
+  const struct builtin* c = find_core(name);
+
+  if (c)
+    return (struct builtin*) c;
+
+  if (!table_used)
+    return NULL;
+
+  struct builtin* b = slot_for(name);
+  return b->name ? b : NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : list_builtins()
+// parameters : none
+// description: Prints every builtin, marking those from plugins
+// --------------------------------------------------------------- //
+void list_builtins() {
+  for (unsigned i = 0; i < BUILTIN_SLOTS; i++) {
+    if (core[i].name)
+      printf("enable %s\n", core[i].name);
+  }
+
+  for (unsigned i = 0; i < table_size; i++) {
+    if (table[i].name && table[i].kind == BUILTIN_PLUGIN)
+      printf("enable %s (plugin)\n", table[i].name);
+  }
+  fflush(stdout);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : load_plugin(..)
+// parameters : const char* path
+// description: dlopens a plugin and lets it register its builtins
+//              Returns 0 on success
+// --------------------------------------------------------------- //
+int load_plugin(const char* path) {
+  void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+  if (!handle) {
+    fprintf(stderr, "enable: %s\n", dlerror());
+    return -1;
+  }
+
+  smallsh_plugin_init_fn init;
+  *(void**) &init = dlsym(handle, "smallsh_plugin_init");
+
+  if (!init) {
+    fprintf(stderr, "enable: %s: no smallsh_plugin_init\n", path);
+    dlclose(handle);
+    return -1;
+  }
+
+  struct smallsh_plugin_api api = { SMALLSH_PLUGIN_ABI, register_plugin_builtin };
+
+  if (init(&api) != 0) {
+    fprintf(stderr, "enable: %s: plugin failed to initialize\n", path);
+    return -1;  // It may have registered builtins already, keep it loaded
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : load_plugins_env()
+// parameters : none
+// description: Loads every plugin listed in SMALLSH_PLUGINS
+// example    : SMALLSH_PLUGINS=/opt/sh/fast.so:/opt/sh/json.so smallsh
+// --------------------------------------------------------------- //
+void load_plugins_env() {
+  char* list = getenv("SMALLSH_PLUGINS");
+  char* saveptr;
+
+  if (!list || !*list)
+    return;
+
+  list = strdup(list);
+  for (char* path = strtok_r(list, ":", &saveptr); path; path = strtok_r(NULL, ":", &saveptr))
+    load_plugin(path);
+
+  free(list);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : run_plugin(..)
+// parameters : struct builtin* b
+//              char* args[]
+//              struct shell_info *info
+// description: Runs a plugin builtin in the shell process. Its
+//              redirections are opened here (see fds_open_io) and
+//              handed over as fds instead of replacing the shell's own
+//              stdin/stdout
+// --------------------------------------------------------------- //
+static int run_plugin(struct builtin* b, char* args[], struct shell_info *info) {
+  int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+  int io[2];
+  int argc = 0;
+
+  while (args[argc])
+    argc++;
+
+  if (fds_open_io(info, io) == -1) {
+    info->exit_status = 1 << 8;
+    return 1;
+  }
+
+  if (io[0] != -1)
+    fds[0] = io[0];
+  if (io[1] != -1)
+    fds[1] = io[1];
+
+  fflush(stdout);  // Keep order with anything the shell printed
+
+  int ret = b->plugin(argc, args, fds, environ);
+  info->exit_status = (ret & 0xff) << 8;  // Encoded like waitpid() status
+
+  if (fds[0] != STDIN_FILENO)
+    close(fds[0]);
+  if (fds[1] != STDOUT_FILENO)
+    close(fds[1]);
+
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : run_builtin(..)
+// parameters : struct builtin* b
+//              char* args[]
+//              struct shell_info *info
+// description: Runs a builtin found by find_builtin()
+//              Returns 0 if the shell should exit
+// --------------------------------------------------------------- //
+int run_builtin(struct builtin* b, char* args[], struct shell_info *info) {
+  if (b->kind == BUILTIN_PLUGIN)
+    return run_plugin(b, args, info);
+
+  return b->fn(b, args, info);
+}
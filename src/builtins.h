@@ -0,0 +1,63 @@
+// builtins.h
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "src/shell_info.h"
+#include "src/smallsh_plugin.h"
+
+struct builtin;
+
+// Builtins run by the shell. Returns 0 to end the shell
+typedef int (*builtin_fn)(struct builtin* self, char* args[], struct shell_info *info);
+
+// Kinds of names the builtin table resolves
+#define BUILTIN_SHELL     0  // compiled into the shell
+#define BUILTIN_PLUGIN    1  // loaded from a shared object
+#define BUILTIN_FUNCTION  2  // defined by the user, body in data
+#define BUILTIN_ALIAS     3  // defined by the user, expansion in data
+
+
+// --------------------------------------------------------------- //
+// structure  : struct builtin
+// description: Entry of the builtin table. Shell builtins and user
+//              functions set fn, plugin builtins set plugin. data is
+//              owned by whoever defined the entry
+// --------------------------------------------------------------- //
+struct builtin {
+  char*           name;
+  int             kind;
+  builtin_fn      fn;
+  smallsh_builtin plugin;
+  void*           data;
+};
+
+// --------------------------------------------------------------- //
+// description: The shell's own builtins are a static table placed by
+//              a perfect hash of (length, first char, last char), so a
+//              lookup is one hash and one strcmp. Entries are written
+//
+//                [BUILTIN_HASH(2, 'c', 'd')] = { "cd", ... },
+//
+//              and two names landing in one slot are a duplicate
+//              initializer, which -Werror=override-init rejects at
+//              compile time. Pick new multipliers if that happens.
+//              Plugins, functions and aliases live in a second, growable
+//              table searched only when the static one misses
+// --------------------------------------------------------------- //
+#define BUILTIN_SLOTS 64
+#define BUILTIN_HASH(len, first, last) \
+  (((len) + (unsigned char) (first) * 3 + (unsigned char) (last) * 5) & (BUILTIN_SLOTS - 1))
+
+void set_core_builtins(const struct builtin* table);
+int define_builtin(const char* name, int kind, builtin_fn fn, void* data);
+void* undefine_builtin(const char* name);
+struct builtin* find_builtin(const char* name);
+void for_each_builtin(int kind, void (*fn)(struct builtin* b));
+void clear_builtins();
+void list_builtins();
+int load_plugin(const char* path);
+void load_plugins_env();
+int run_builtin(struct builtin* b, char* args[], struct shell_info *info);
+
+#endif
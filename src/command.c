@@ -0,0 +1,282 @@
+// command.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/command.h"
+#include "src/arg_vec.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct parser
+// description: Tokens of the line being parsed and the position in
+//              them. error is set on the first syntax error
+// --------------------------------------------------------------- //
+struct parser {
+  char**        tokens;
+  int           pos;
+  struct arena* arena;
+  const char*   error;
+};
+
+
+static int is(struct parser *p, const char* token) {
+  return p->tokens[p->pos] && strcmp(p->tokens[p->pos], token) == 0;
+}
+
+static int at_end(struct parser *p) {  // Of a command
+  return !p->tokens[p->pos] || is(p, ";") || is(p, "}") || is(p, ")") ||
+         is(p, "&&") || is(p, "||");
+}
+
+
+// --------------------------------------------------------------- //
+// function   : split_words(..)
+// parameters : char* words[]
+//              struct arg_vec *tokens
+// description: Splits ( off the front and ) and ; off the end of
+//              words, so "(cd /tmp;" is read as "(", "cd", "/tmp", ";"
+//              Braces must stand alone, as in sh
+// --------------------------------------------------------------- //
+static void split_words(char* words[], struct arg_vec *tokens) {
+  for (int i = 0; words[i]; i++) {
+    char* w = words[i];
+    size_t len = strlen(w);
+    int tail = 0;
+
+    while (len > 1 && w[0] == '(') {
+      arg_vec_push(tokens, "(");
+      w++;
+      len--;
+    }
+
+    while (len - tail > 1 && (w[len - tail - 1] == ')' || w[len - tail - 1] == ';'))
+      tail++;
+
+    if (tail) {
+      char* word = arena_strdup(tokens->arena, w);
+      word[len - tail] = '\0';
+      arg_vec_push(tokens, word);
+
+      for (size_t c = len - tail; c < len; c++)
+        arg_vec_push(tokens, w[c] == ')' ? ")" : ";");
+    } else {
+      arg_vec_push(tokens, w);
+    }
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : take_words(..)
+// parameters : struct parser *p
+// description: Collects words up to the next ; && || or closing
+//              bracket. Returns them NULL terminated (empty for a bare
+//              group)
+// --------------------------------------------------------------- //
+static char** take_words(struct parser *p) {
+  struct arg_vec words;
+
+  arg_vec_init(&words, p->arena);
+
+  while (!at_end(p)) {
+    if (is(p, "{") || is(p, "(")) {
+      p->error = p->tokens[p->pos];  // A group must start a command
+      break;
+    }
+    arg_vec_push(&words, p->tokens[p->pos++]);
+  }
+
+  return words.items;
+}
+
+
+static struct command* parse_list(struct parser *p, const char* close);
+
+
+// --------------------------------------------------------------- //
+// function   : parse_command(..)
+// parameters : struct parser *p
+// description: Parses one simple command or group
+// --------------------------------------------------------------- //
+static struct command* parse_command(struct parser *p) {
+  struct command* c = arena_alloc(p->arena, sizeof(struct command));
+
+  memset(c, 0, sizeof(*c));
+
+  if (is(p, "{") || is(p, "(")) {
+    const char* close = is(p, "{") ? "}" : ")";
+
+    c->kind = is(p, "{") ? CMD_BRACE : CMD_SUBSHELL;
+    p->pos++;
+    c->body = parse_list(p, close);
+
+    if (p->error)
+      return c;
+
+    if (!is(p, close) || !c->body) {
+      p->error = p->tokens[p->pos] ? p->tokens[p->pos] : "end of line";
+      return c;
+    }
+    p->pos++;
+  }
+
+  c->words = take_words(p);  // Command, or a group's redirections
+  return c;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_list(..)
+// parameters : struct parser *p
+//              const char* close
+// description: Parses commands separated by ; && or || up to the
+//              bracket close (NULL at the top level). Empty commands
+//              between ; are skipped, but && and || need a command on
+//              each side. Returns the first command, NULL if none
+// --------------------------------------------------------------- //
+static struct command* parse_list(struct parser *p, const char* close) {
+  struct command* first = NULL;
+  struct command** link = &first;
+
+  while (p->tokens[p->pos] && !p->error) {
+    if (is(p, ";")) {
+      p->pos++;
+      continue;
+    }
+
+    if (is(p, "}") || is(p, ")")) {
+      if (!close || !is(p, close))
+        p->error = p->tokens[p->pos];
+      break;
+    }
+
+    if (is(p, "&&") || is(p, "||")) {  // No command before it
+      p->error = p->tokens[p->pos];
+      break;
+    }
+
+    *link = parse_command(p);
+
+    if (!p->error && (is(p, "&&") || is(p, "||"))) {
+      (*link)->join = is(p, "&&") ? JOIN_AND : JOIN_OR;
+      p->pos++;
+
+      if (at_end(p))  // No command after it
+        p->error = p->tokens[p->pos] ? p->tokens[p->pos] : "end of line";
+    }
+
+    link = &(*link)->next;
+  }
+
+  return first;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_commands(..)
+// parameters : char* words[]
+//              struct arena *a
+//              const char** error
+// description: Parses a line holding ( ... ) or { ...; } groups, or
+//              commands joined by ; && ||, into a list of commands,
+//              allocated in a. On a syntax error, returns NULL with
+//              error set to the offending token
+// example    : { echo a; echo b; } > out  ->  brace group of two
+//              commands, with words "> out"
+//              make && make install || echo failed  ->  three commands
+//              joined by JOIN_AND and JOIN_OR
+// --------------------------------------------------------------- //
+struct command* parse_commands(char* words[], struct arena *a, const char** error) {
+  struct arg_vec tokens;
+  struct parser p = { NULL, 0, a, NULL };
+
+  arg_vec_init(&tokens, a);
+  split_words(words, &tokens);
+  p.tokens = tokens.items;
+
+  struct command* list = parse_list(&p, NULL);
+
+  *error = p.error;
+  return p.error ? NULL : list;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : copy_words(..)
+// parameters : char** words
+// description: Returns a malloc'd copy of a NULL terminated array of
+//              words
+// --------------------------------------------------------------- //
+static char** copy_words(char** words) {
+  int n = 0;
+
+  while (words && words[n])
+    n++;
+
+  char** copy = malloc((n + 1) * sizeof(char*));
+
+  if (!copy) {
+    perror("malloc");
+    exit(1);
+  }
+
+  for (int i = 0; i < n; i++)
+    copy[i] = strdup(words[i]);
+  copy[n] = NULL;
+
+  return copy;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : copy_command(..)
+// parameters : const struct command* c
+// description: Returns a malloc'd copy of command c and everything in
+//              it, but not the commands after it, for keeping a group
+//              past the arena it was parsed into. Freed with
+//              free_command()
+// --------------------------------------------------------------- //
+struct command* copy_command(const struct command* c) {
+  struct command* copy = malloc(sizeof(struct command));
+
+  if (!copy) {
+    perror("malloc");
+    exit(1);
+  }
+
+  copy->kind = c->kind;
+  copy->join = c->join;
+  copy->words = copy_words(c->words);
+  copy->body = NULL;
+  copy->next = NULL;
+
+  struct command** link = &copy->body;
+
+  for (const struct command* in = c->body; in; in = in->next) {
+    *link = copy_command(in);
+    link = &(*link)->next;
+  }
+
+  return copy;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : free_command(..)
+// parameters : struct command* c
+// description: Frees a copy_command() copy
+// --------------------------------------------------------------- //
+void free_command(struct command* c) {
+  struct command* next;
+
+  for (struct command* in = c->body; in; in = next) {
+    next = in->next;
+    free_command(in);
+  }
+
+  for (int i = 0; c->words[i]; i++)
+    free(c->words[i]);
+  free(c->words);
+  free(c);
+}
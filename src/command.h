@@ -0,0 +1,40 @@
+// command.h
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include "src/arena.h"
+
+// Kinds of struct command
+#define CMD_SIMPLE    0  // words run like a line of their own
+#define CMD_BRACE     1  // { list; } runs in the shell itself
+#define CMD_SUBSHELL  2  // ( list ) runs in a copy of the shell
+
+// How a command is joined to the next one of its list
+#define JOIN_SEQ  0  // ;   the next always runs
+#define JOIN_AND  1  // &&  the next runs if this one succeeded
+#define JOIN_OR   2  // ||  the next runs if this one failed
+
+
+// --------------------------------------------------------------- //
+// structure  : struct command
+// description: One command of a list parsed from a line with groups
+//              or ; && || between commands
+//              A simple command's words are kept as written (aliases,
+//              < > & and $ are handled when it runs). For a group,
+//              words are what follows the closing bracket, the
+//              redirections and & that apply to the whole group
+// --------------------------------------------------------------- //
+struct command {
+  int    kind;
+  int    join;           // JOIN_*, to next
+  char** words;          // NULL terminated
+  struct command* body;  // Groups: first command inside
+  struct command* next;  // Next command of the list
+};
+
+struct command* parse_commands(char* words[], struct arena *a, const char** error);
+struct command* copy_command(const struct command* c);
+void            free_command(struct command* c);
+
+#endif
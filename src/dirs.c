@@ -0,0 +1,437 @@
+// dirs.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#include "src/dirs.h"
+
+#define DIR_CACHE  16  // Directory fds kept open
+#define DIR_STACK  64  // Deepest pushd
+
+// --------------------------------------------------------------- //
+// structure  : struct dir_entry
+// description: A directory held open by path. Before reuse, its entry
+//              in its parent is looked up from the fd and must still
+//              be the same dev and inode: removing or renaming it, or
+//              replacing it with another, drops it from the cache
+// --------------------------------------------------------------- //
+struct dir_entry {
+  char*  path;  // Absolute, normalized
+  int    fd;    // O_PATH | O_DIRECTORY
+  dev_t  dev;
+  ino_t  ino;
+  unsigned long   used;  // For least recently used eviction
+};
+
+static struct dir_entry cache[DIR_CACHE];
+static struct dir_entry stack[DIR_STACK];  // pushd stack, fds owned here
+static int   stack_len = 0;
+static unsigned long clock_tick = 0;
+
+static char* cwd_path = NULL;  // Logical working directory, like $PWD
+static int   cwd_fd = AT_FDCWD;
+static int   beneath = 0;      // Redirections must stay under the cwd
+
+
+// --------------------------------------------------------------- //
+// function   : normalize(..)
+// parameters : const char* base
+//              const char* path
+// description: Returns a new absolute path for path taken relative to
+//              base, with ".", ".." and repeated slashes resolved
+//              lexically (the way cd -L does)
+// --------------------------------------------------------------- //
+static char* normalize(const char* base, const char* path) {
+  size_t size = strlen(base) + strlen(path) + 3;
+  char* out = malloc(size);
+  size_t len = 0;
+
+  if (path[0] != '/') {  // Start from base
+    len = strlen(base);
+    memcpy(out, base, len);
+  }
+
+  const char* p = path;
+  while (*p) {
+    while (*p == '/')
+      p++;
+
+    const char* end = p;
+    while (*end && *end != '/')
+      end++;
+
+    size_t n = end - p;
+
+    if (n == 0 || (n == 1 && p[0] == '.')) {
+      // Nothing to add
+    } else if (n == 2 && p[0] == '.' && p[1] == '.') {
+      while (len > 0 && out[len - 1] != '/')  // Drop last component
+        len--;
+      if (len > 0)
+        len--;
+    } else {
+      out[len++] = '/';
+      memcpy(out + len, p, n);
+      len += n;
+    }
+
+    p = end;
+  }
+
+  if (len == 0)
+    out[len++] = '/';
+  out[len] = '\0';
+
+  return out;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : still_there(..)
+// parameters : struct dir_entry *e
+// description: Returns 1 if the directory e's fd holds is still in its
+//              parent under the last component of its path. Looked up
+//              from the fd ("../name") rather than the whole path, so
+//              it costs two components whatever the depth. A removed
+//              directory has no ".." left to look up. A rename further
+//              up isn't seen: the entry follows its directory, as the
+//              cwd and the pushd stack do
+// --------------------------------------------------------------- //
+static int still_there(struct dir_entry *e) {
+  char up[NAME_MAX + 4];
+  struct stat st;
+
+  snprintf(up, sizeof(up), "../%s", strrchr(e->path, '/') + 1);
+
+  return fstatat(e->fd, up, &st, 0) == 0 && st.st_dev == e->dev &&
+         st.st_ino == e->ino;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : open_dir(..)
+// parameters : const char* path
+// description: Returns an fd for the absolute directory path from the
+//              cache, opening and caching it on a miss. The cache owns
+//              the fd. Returns -1 with errno set on failure
+// --------------------------------------------------------------- //
+static int open_dir(const char* path) {
+  struct dir_entry* victim = &cache[0];
+
+  for (int i = 0; i < DIR_CACHE; i++) {
+    struct dir_entry* e = &cache[i];
+
+    if (e->path && strcmp(e->path, path) == 0) {
+      if (still_there(e)) {
+        e->used = ++clock_tick;
+        return e->fd;
+      }
+      victim = e;  // Stale, replace in place
+      break;
+    }
+
+    if (!e->path || e->used < victim->used)
+      victim = e;
+  }
+
+  int fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+  struct stat st;
+
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return -1;
+  }
+
+  if (victim->path) {
+    close(victim->fd);
+    free(victim->path);
+  }
+
+  victim->path = strdup(path);
+  victim->fd = fd;
+  victim->dev = st.st_dev;
+  victim->ino = st.st_ino;
+  victim->used = ++clock_tick;
+
+  return fd;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : set_cwd(..)
+// parameters : char* path
+//              int fd
+// description: Makes directory path, open as fd, the working
+//              directory. Takes ownership of both. Returns 0 on success
+// --------------------------------------------------------------- //
+static int set_cwd(char* path, int fd) {
+  if (fchdir(fd) == -1) {
+    free(path);
+    close(fd);
+    return -1;
+  }
+
+  if (cwd_fd != AT_FDCWD)
+    close(cwd_fd);
+  free(cwd_path);
+
+  cwd_path = path;
+  cwd_fd = fd;
+  setenv("PWD", path, 1);
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dirs_init(..)
+// parameters : int confine
+// description: Records the starting directory. With confine set,
+//              redirections may only name files beneath the cwd
+// --------------------------------------------------------------- //
+void dirs_init(int confine) {
+  beneath = confine;
+  stack_len = 0;  // Fresh stack, also in a forked copy of the shell
+  cwd_path = getcwd(NULL, 0);
+
+  if (cwd_path)
+    cwd_fd = open(cwd_path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+  if (!cwd_path || cwd_fd == -1) {  // cwd is gone, fall back to plain paths
+    free(cwd_path);
+    cwd_path = strdup("/");
+    cwd_fd = AT_FDCWD;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_cd(..)
+// parameters : const char* path
+// description: Changes the working directory to path. Directories
+//              visited recently are switched to by fd with no path
+//              lookup. Returns 0 on success
+// --------------------------------------------------------------- //
+int dir_cd(const char* path) {
+  char* target = normalize(cwd_path, path);
+  int fd = open_dir(target);
+
+  if (fd == -1 || (fd = fcntl(fd, F_DUPFD_CLOEXEC, 3)) == -1) {
+    free(target);
+    return -1;
+  }
+
+  return set_cwd(target, fd);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_save(..)
+// parameters : char** path
+// description: Takes a copy of the working directory, as its path in
+//              *path and an fd returned, for dir_restore() to go back
+//              to. Returns -1 if the directory can't be held open
+// --------------------------------------------------------------- //
+int dir_save(char** path) {
+  int fd = cwd_fd == AT_FDCWD ? open(".", O_PATH | O_DIRECTORY | O_CLOEXEC)
+                              : fcntl(cwd_fd, F_DUPFD_CLOEXEC, 3);
+
+  if (fd == -1)
+    return -1;
+
+  *path = strdup(cwd_path);
+  return fd;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_restore(..)
+// parameters : char* path
+//              int fd
+// description: Returns to a directory saved by dir_save(), taking
+//              ownership of both. Returns 0 on success
+// --------------------------------------------------------------- //
+int dir_restore(char* path, int fd) {
+  return set_cwd(path, fd);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_pushd(..)
+// parameters : const char* path
+// description: Saves the cwd on the stack and changes to path. With
+//              no path, swaps the cwd with the top of the stack
+//              The stack holds directory fds, so returning to one is
+//              an fchdir() with no path lookup. Returns 0 on success
+// --------------------------------------------------------------- //
+int dir_pushd(const char* path) {
+  struct dir_entry here = { .path = cwd_path, .fd = cwd_fd };
+
+  if (!path) {  // Swap with top
+    if (stack_len == 0) {
+      errno = ENOENT;
+      return -1;
+    }
+
+    struct dir_entry top = stack[stack_len - 1];
+
+    if (fchdir(top.fd) == -1)
+      return -1;
+
+    stack[stack_len - 1] = here;
+    cwd_path = top.path;
+    cwd_fd = top.fd;
+    setenv("PWD", cwd_path, 1);
+    return 0;
+  }
+
+  if (stack_len == DIR_STACK || cwd_fd == AT_FDCWD) {
+    errno = ENOSPC;
+    return -1;
+  }
+
+  char* target = normalize(cwd_path, path);
+  int fd = open_dir(target);
+
+  if (fd == -1 || (fd = fcntl(fd, F_DUPFD_CLOEXEC, 3)) == -1 || fchdir(fd) == -1) {
+    if (fd != -1)
+      close(fd);
+    free(target);
+    return -1;
+  }
+
+  stack[stack_len++] = here;  // The stack now owns the old cwd
+  cwd_path = target;
+  cwd_fd = fd;
+  setenv("PWD", cwd_path, 1);
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_popd()
+// parameters : none
+// description: Returns to the directory on top of the stack
+//              Returns 0 on success
+// --------------------------------------------------------------- //
+int dir_popd() {
+  if (stack_len == 0) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  struct dir_entry top = stack[stack_len - 1];
+
+  if (set_cwd(top.path, top.fd) == -1) {
+    stack_len--;  // Directory is unusable, drop it anyway
+    return -1;
+  }
+
+  stack_len--;
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_print_stack()
+// parameters : none
+// description: Prints the cwd followed by the pushd stack
+// --------------------------------------------------------------- //
+void dir_print_stack() {
+  printf("%s", cwd_path);
+
+  for (int i = stack_len - 1; i >= 0; i--)
+    printf(" %s", stack[i].path);
+
+  printf("\n");
+  fflush(stdout);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_warm(..)
+// parameters : const char* path
+// description: Called by the shell before forking a command that
+//              redirects to path, so the directory it is in is open
+//              in the cache the child inherits
+// --------------------------------------------------------------- //
+void dir_warm(const char* path) {
+  const char* slash = strrchr(path, '/');
+
+  if (path[0] != '/' || beneath || slash == path)
+    return;  // Relative and top level paths start from a held fd already
+
+  char* dir = strndup(path, slash - path);
+  open_dir(dir);
+  free(dir);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : find_dir(..)
+// parameters : const char* path
+//              size_t len
+// description: Returns the cached fd for the first len bytes of path,
+//              or -1 if there is none or it no longer names the same
+//              directory
+// --------------------------------------------------------------- //
+static int find_dir(const char* path, size_t len) {
+  for (int i = 0; i < DIR_CACHE; i++) {
+    if (cache[i].path && strncmp(cache[i].path, path, len) == 0 && !cache[i].path[len])
+      return still_there(&cache[i]) ? cache[i].fd : -1;
+  }
+  return -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : dir_open(..)
+// parameters : const char* path
+//              int flags
+//              int mode
+// description: Opens a redirection target. Relative paths resolve
+//              from the held cwd fd; absolute ones from their
+//              directory's fd when dir_warm() cached it. When confined,
+//              openat2(RESOLVE_BENEATH) refuses anything outside the
+//              cwd, including through '..' and symlinks
+// --------------------------------------------------------------- //
+int dir_open(const char* path, int flags, int mode) {
+  if (beneath) {
+    struct open_how how = { 0 };
+    how.flags = flags;
+    how.mode = (flags & O_CREAT) ? mode : 0;
+    how.resolve = RESOLVE_BENEATH;
+
+    int fd = syscall(SYS_openat2, cwd_fd, path, &how, sizeof(how));
+    if (fd != -1 || errno != ENOSYS)
+      return fd;
+
+    // No openat2 (before Linux 5.6): refuse the obvious escapes
+    if (path[0] == '/' || strstr(path, "..")) {
+      errno = EXDEV;
+      return -1;
+    }
+  }
+
+  if (path[0] != '/')
+    return openat(cwd_fd, path, flags, mode);
+
+  const char* slash = strrchr(path, '/');
+  int dirfd = slash == path ? -1 : find_dir(path, slash - path);
+
+  if (dirfd != -1)
+    return openat(dirfd, slash + 1, flags, mode);
+
+  return open(path, flags, mode);
+}
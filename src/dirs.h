@@ -0,0 +1,24 @@
+// dirs.h
+
+#ifndef DIRS_H
+#define DIRS_H
+
+
+// --------------------------------------------------------------- //
+// description: Working directory handling built on directory fds.
+//              The shell keeps an O_PATH fd for its cwd, a small cache
+//              of fds for recently used directories and the pushd
+//              stack as fds, so switching directories is an fchdir()
+//              and redirections resolve relative to a held directory
+// --------------------------------------------------------------- //
+void dirs_init(int beneath);
+int  dir_cd(const char* path);
+int  dir_save(char** path);
+int  dir_restore(char* path, int fd);
+int  dir_pushd(const char* path);
+int  dir_popd();
+void dir_print_stack();
+void dir_warm(const char* path);
+int  dir_open(const char* path, int flags, int mode);
+
+#endif
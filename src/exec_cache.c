@@ -0,0 +1,241 @@
+// exec_cache.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "src/exec_cache.h"
+
+#define EXEC_CACHE 64  // Direct mapped, a collision replaces the entry
+
+extern char** environ;
+
+// --------------------------------------------------------------- //
+// structure  : struct exec_entry
+// description: A command found on PATH. The binary is held open so
+//              children exec it with execveat() and no path lookup.
+//              Before each use, one stat() of path checks it is still
+//              the same file (device, inode and mtime)
+// --------------------------------------------------------------- //
+struct exec_entry {
+  char*  name;
+  char*  path;
+  int    fd;       // -1 for #! scripts, see exec_lookup
+  dev_t  dev;
+  ino_t  ino;
+  struct timespec mtime;
+  int    probes;   // PATH entries execvp() would try to reach it
+  unsigned long hits;
+};
+
+static struct exec_entry cache[EXEC_CACHE];
+static char* cache_path = NULL;  // PATH the entries were found with
+
+// Counters for 'hash'
+static unsigned long stat_hits = 0;
+static unsigned long stat_misses = 0;
+static unsigned long stat_stale = 0;
+static unsigned long stat_avoided = 0;  // Path resolutions not done
+
+
+static unsigned hash_name(const char* name) {
+  unsigned h = 2166136261u;
+  while (*name) {
+    h ^= (unsigned char) *name++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+
+static void drop(struct exec_entry *e) {
+  if (e->fd != -1)
+    close(e->fd);
+  free(e->name);
+  free(e->path);
+  memset(e, 0, sizeof(*e));
+  e->fd = -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : exec_cache_clear()
+// parameters : none
+// description: Forgets every command (hash -r)
+// --------------------------------------------------------------- //
+void exec_cache_clear() {
+  for (int i = 0; i < EXEC_CACHE; i++) {
+    if (cache[i].name)
+      drop(&cache[i]);
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : search_path(..)
+// parameters : const char* name
+//              struct exec_entry *e
+// description: Finds name on PATH the way execvp would, filling in e
+//              Returns 0 if found
+// --------------------------------------------------------------- //
+static int search_path(const char* name, struct exec_entry *e) {
+  const char* dirs = getenv("PATH");
+  struct stat st;
+  int probes = 0;
+
+  if (!dirs)
+    dirs = "/bin:/usr/bin";
+
+  while (*dirs) {
+    const char* end = strchrnul(dirs, ':');
+    size_t len = end - dirs;
+    char* path = malloc(len + strlen(name) + 3);
+
+    if (len == 0)  // Empty entry means the current directory
+      sprintf(path, "./%s", name);
+    else
+      sprintf(path, "%.*s/%s", (int) len, dirs, name);
+
+    probes++;
+
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0) {
+      e->path = path;
+      e->dev = st.st_dev;
+      e->ino = st.st_ino;
+      e->mtime = st.st_mtim;
+      e->probes = probes;
+      return 0;
+    }
+
+    free(path);
+    dirs = *end ? end + 1 : end;
+  }
+
+  return -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_script(..)
+// parameters : const char* path
+// description: Returns 1 if path starts with #!. Scripts can't run
+//              from a close-on-exec fd: the kernel hands the
+//              interpreter a /dev/fd path that is gone by then
+// --------------------------------------------------------------- //
+static int is_script(const char* path) {
+  char magic[2] = { 0 };
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1)
+    return 1;  // Can't tell, let exec by path handle it
+
+  int n = read(fd, magic, 2);
+  close(fd);
+
+  return n == 2 && magic[0] == '#' && magic[1] == '!';
+}
+
+
+// --------------------------------------------------------------- //
+// function   : exec_lookup(..)
+// parameters : const char* name
+//              struct exec_target *t
+// description: Decides how to exec name. Names containing '/' are
+//              exec'd as given. Others come from the cache when the
+//              file on disk is unchanged, and are looked up on PATH
+//              and cached otherwise. If nothing is found, the child
+//              falls back to execvp for its usual error
+// --------------------------------------------------------------- //
+void exec_lookup(const char* name, struct exec_target *t) {
+  t->fd = -1;
+  t->path = NULL;
+
+  if (strchr(name, '/')) {
+    t->path = (char*) name;
+    return;
+  }
+
+  const char* path = getenv("PATH");
+  if (!cache_path || strcmp(cache_path, path ? path : "") != 0) {  // PATH changed
+    exec_cache_clear();
+    free(cache_path);
+    cache_path = strdup(path ? path : "");
+  }
+
+  struct exec_entry* e = &cache[hash_name(name) & (EXEC_CACHE - 1)];
+  struct stat st;
+
+  if (e->name && strcmp(e->name, name) == 0) {
+    if (stat(e->path, &st) == 0 && st.st_dev == e->dev && st.st_ino == e->ino &&
+        st.st_mtim.tv_sec == e->mtime.tv_sec && st.st_mtim.tv_nsec == e->mtime.tv_nsec) {
+      e->hits++;
+      stat_hits++;
+      stat_avoided += e->probes;  // One stat instead of a PATH walk and exec by path
+      t->fd = e->fd;
+      t->path = e->path;
+      return;
+    }
+
+    stat_stale++;
+  }
+
+  stat_misses++;
+
+  struct exec_entry found = { 0 };
+  if (search_path(name, &found) != 0)
+    return;
+
+  if (e->name)
+    drop(e);
+
+  *e = found;
+  e->name = strdup(name);
+  e->fd = is_script(e->path) ? -1 : open(e->path, O_PATH | O_CLOEXEC);
+
+  t->fd = e->fd;
+  t->path = e->path;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : exec_run(..)
+// parameters : struct exec_target *t
+//              char* args[]
+// description: Called in the child to exec the command exec_lookup()
+//              chose, falling back to execvp(). Only returns on
+//              failure, with errno set
+// --------------------------------------------------------------- //
+void exec_run(struct exec_target *t, char* args[]) {
+  if (t->fd != -1) {
+    syscall(SYS_execveat, t->fd, "", args, environ, AT_EMPTY_PATH);
+    // Kernel without execveat, try the path below
+  }
+
+  if (t->path)
+    execv(t->path, args);
+
+  execvp(args[0], args);  // Also runs files without #! through sh
+}
+
+
+// --------------------------------------------------------------- //
+// function   : exec_cache_print()
+// parameters : none
+// description: Lists cached commands and the cache counters (hash)
+// --------------------------------------------------------------- //
+void exec_cache_print() {
+  printf("hits\tcommand\n");
+
+  for (int i = 0; i < EXEC_CACHE; i++) {
+    if (cache[i].name)
+      printf("%lu\t%s%s\n", cache[i].hits, cache[i].path, cache[i].fd == -1 ? " (by path)" : "");
+  }
+
+  printf("%lu hits, %lu misses, %lu stale, %lu path lookups avoided\n",
+         stat_hits, stat_misses, stat_stale, stat_avoided);
+  fflush(stdout);
+}
@@ -0,0 +1,23 @@
+// exec_cache.h
+
+#ifndef EXEC_CACHE_H
+#define EXEC_CACHE_H
+
+
+// --------------------------------------------------------------- //
+// structure  : struct exec_target
+// description: How a child should exec a command, worked out by the
+//              parent before fork. fd is an O_PATH descriptor for the
+//              binary (-1 to use path, or execvp when path is NULL)
+// --------------------------------------------------------------- //
+struct exec_target {
+  int   fd;
+  char* path;
+};
+
+void exec_lookup(const char* name, struct exec_target *t);
+void exec_run(struct exec_target *t, char* args[]);
+void exec_cache_clear();
+void exec_cache_print();
+
+#endif
@@ -0,0 +1,302 @@
+// fds.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "src/fds.h"
+#include "src/dirs.h"
+#include "src/shell_info.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct held_fd
+// description: Descriptor N held for the user. fd is where it really
+//              is: N itself, or a close-on-exec copy at 10 or above
+//              when N was taken by one of the shell's own fds
+// --------------------------------------------------------------- //
+struct held_fd {
+  int   used;
+  int   fd;
+  char* what;  // As given to exec, for listing
+};
+
+static struct held_fd held[FDS_MAX];
+
+
+// --------------------------------------------------------------- //
+// function   : is_open(..)
+// parameters : int fd
+// description: Returns 1 if fd is an open descriptor
+// --------------------------------------------------------------- //
+static int is_open(int fd) {
+  return fcntl(fd, F_GETFD) != -1 || errno != EBADF;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : release(..)
+// parameters : int n
+// description: Closes descriptor n if the shell holds it for the user
+// --------------------------------------------------------------- //
+static void release(int n) {
+  if (!held[n].used)
+    return;
+
+  if (n == 1)
+    fflush(stdout);
+
+  close(held[n].fd);
+  free(held[n].what);
+  held[n].used = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : place(..)
+// parameters : int n
+//              int fd
+//              const char* what
+// description: Holds fd as descriptor n, taking ownership of fd
+//              0-2 and any free n get the file at n itself, left open
+//              across exec so children inherit it for free
+// --------------------------------------------------------------- //
+static void place(int n, int fd, const char* what) {
+  release(n);
+
+  if (n <= 2 || !is_open(n)) {
+    if (n == 1)
+      fflush(stdout);  // Output so far goes where it was headed
+
+    dup2(fd, n);
+    close(fd);
+    fd = n;
+
+  } else if (fd < FDS_MAX) {  // Keep 0-9 free for later exec N
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, FDS_MAX);
+    close(fd);
+    fd = high;
+  }
+
+  held[n].used = 1;
+  held[n].fd = fd;
+  held[n].what = strdup(what);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fds_redirect(..)
+// parameters : char* word
+//              char* next
+// description: Carries out one exec redirection, N>file, N>>file,
+//              N<file, N>&M or N>&-. The file may also be the next
+//              word (exec 3> log). Returns the number of words used,
+//              or -1 after printing why it failed
+// --------------------------------------------------------------- //
+static int fds_redirect(char* word, char* next) {
+  int n = word[0] - '0';
+  char* op = word + 1;
+  char* target;
+  char what[300];
+  int used = 1;
+  int flags;
+  int fd;
+
+  if (strncmp(op, ">>", 2) == 0 || strncmp(op, ">&", 2) == 0 || strncmp(op, "<&", 2) == 0)
+    target = op + 2;
+  else
+    target = op + 1;
+
+  if (!target[0]) {  // exec 3> log
+    if (!next) {
+      printf("exec: %s needs a file \n", word);
+      fflush(stdout);
+      return -1;
+    }
+    target = next;
+    used = 2;
+  }
+
+  int op_len = target == next ? (int) strlen(op) : (int) (target - op);
+  snprintf(what, sizeof(what), "%.*s%s", op_len, op, target);
+
+  if (op[1] == '&') {  // Duplicate or close
+    if (strcmp(target, "-") == 0) {
+      if (held[n].used)
+        release(n);
+      else if (n <= 2)
+        close(n);  // Never one of the shell's own fds
+      return used;
+    }
+
+    int m = target[0] - '0';
+
+    if (target[1] || fds_get(m) == -1 || !is_open(fds_get(m))) {
+      printf("exec: %s: bad file descriptor \n", target);
+      fflush(stdout);
+      return -1;
+    }
+
+    place(n, fcntl(fds_get(m), F_DUPFD_CLOEXEC, FDS_MAX), what);
+    return used;
+  }
+
+  if (op[0] == '<')
+    flags = O_RDONLY;
+  else if (op[1] == '>')
+    flags = O_WRONLY | O_CREAT | O_APPEND;
+  else
+    flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+  if ((fd = dir_open(target, flags | O_CLOEXEC, 0777)) == -1) {
+    perror(target);
+    return -1;
+  }
+
+  place(n, fd, what);
+  return used;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fds_exec(..)
+// parameters : char* args[]
+// description: The exec builtin. Opens, duplicates or closes numbered
+//              descriptors for the shell and every command after it
+//              With no arguments, lists them
+//              Returns 0 on success, 1 if a file won't open, 2 on
+//              words it doesn't understand
+// example    : exec 3>>build.log  then  make >&3
+// --------------------------------------------------------------- //
+int fds_exec(char* args[]) {
+  if (!args[1]) {
+    fds_print();
+    return 0;
+  }
+
+  for (int i = 1; args[i]; ) {
+    char* w = args[i];
+
+    if (!(w[0] >= '0' && w[0] <= '9' && (w[1] == '>' || w[1] == '<'))) {
+      printf("usage: exec N>file | N>>file | N<file | N>&M | N>&- \n");
+      fflush(stdout);
+      return 2;
+    }
+
+    int used = fds_redirect(w, args[i + 1]);
+
+    if (used == -1)
+      return 1;
+    i += used;
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fds_get(..)
+// parameters : int n
+// description: Returns the descriptor to use for the user's n: the
+//              shell's copy if exec moved it, else n itself. 3-9 not
+//              opened by exec are -1, so >&N never reaches one of the
+//              shell's own fds
+// --------------------------------------------------------------- //
+int fds_get(int n) {
+  if (n < 0 || n >= FDS_MAX)
+    return -1;
+
+  return held[n].used ? held[n].fd : n <= 2 ? n : -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fds_open_io(..)
+// parameters : struct shell_info *info
+//              int fds[2]
+// description: Opens a command's redirections the way a child applies
+//              them, < file, > file, >> file, then <&N and >&N in
+//              their place, as close-on-exec fds in fds[0] (input)
+//              and fds[1] (output), -1 where there is none. For
+//              commands run in the shell itself, which must not lose
+//              its own stdin and stdout. Returns -1 after printing
+//              why, with nothing left open
+// --------------------------------------------------------------- //
+int fds_open_io(struct shell_info *info, int fds[2]) {
+  fds[0] = fds[1] = -1;
+
+  if (info->input_redirect &&
+      (fds[0] = dir_open(info->input_filename, O_RDONLY | O_CLOEXEC, 0)) == -1) {
+    perror("Input file could not be opened \n");
+    return -1;
+  }
+
+  if (info->output_redirect &&
+      (fds[1] = dir_open(info->output_filename, O_WRONLY | O_CREAT | O_CLOEXEC |
+                         (info->output_append ? O_APPEND : O_TRUNC), 0777)) == -1) {
+    perror("Output file could not be opened \n");
+    if (fds[0] != -1)
+      close(fds[0]);
+    return -1;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    int n = i ? info->output_fd : info->input_fd;
+
+    if (n == -1)
+      continue;
+
+    if (fds[i] != -1)
+      close(fds[i]);
+
+    if ((fds[i] = fcntl(fds_get(n), F_DUPFD_CLOEXEC, FDS_MAX)) == -1) {
+      fprintf(stderr, "%d: ", n);
+      perror("bad file descriptor");
+      if (fds[!i] != -1)
+        close(fds[!i]);
+      fds[!i] = -1;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fds_install(..)
+// parameters : int keep
+// description: Called in a child before exec. Puts descriptors the
+//              shell holds away from their number at that number. keep
+//              is an fd the child still needs (the binary to exec); if
+//              it is in the way it is moved, and its new number returned
+// --------------------------------------------------------------- //
+int fds_install(int keep) {
+  for (int n = 0; n < FDS_MAX; n++) {
+    if (!held[n].used || held[n].fd == n)
+      continue;
+
+    if (keep == n)
+      keep = fcntl(keep, F_DUPFD_CLOEXEC, FDS_MAX);
+
+    dup2(held[n].fd, n);
+  }
+
+  return keep;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : fds_print()
+// parameters : none
+// description: Lists held descriptors as they were opened (exec)
+// --------------------------------------------------------------- //
+void fds_print() {
+  for (int n = 0; n < FDS_MAX; n++) {
+    if (held[n].used)
+      printf("%d%s\n", n, held[n].what);
+  }
+  fflush(stdout);
+}
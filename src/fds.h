@@ -0,0 +1,25 @@
+// fds.h
+
+#ifndef FDS_H
+#define FDS_H
+
+
+// --------------------------------------------------------------- //
+// description: Numbered descriptors opened by exec N>file and kept
+//              by the shell for every later command, so a log written
+//              by hundreds of commands is opened once. Where N is free
+//              the file sits at N itself and children inherit it as is;
+//              where the shell already uses N for its own fds it is
+//              kept elsewhere and moved to N in each child
+// --------------------------------------------------------------- //
+#define FDS_MAX 10  // exec takes N from 0 to 9, as in sh
+
+struct shell_info;
+
+int  fds_exec(char* args[]);
+int  fds_get(int n);
+int  fds_open_io(struct shell_info *info, int fds[2]);
+int  fds_install(int keep);
+void fds_print();
+
+#endif
@@ -0,0 +1,179 @@
+// jobs.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include "src/jobs.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct job
+// description: A background job. done is 0 while it runs, then the
+//              order it finished in, so completions are handed out
+//              oldest first
+// --------------------------------------------------------------- //
+struct job {
+  pid_t         pid;
+  int           status;
+  unsigned long done;
+};
+
+static struct job* jobs = NULL;
+static int jobs_len = 0;
+static int jobs_cap = 0;
+static int jobs_done = 0;       // Finished, not yet collected
+static unsigned long done_seq = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : drop(..)
+// parameters : int i
+// description: Removes job i, keeping the rest in launch order
+// --------------------------------------------------------------- //
+static void drop(int i) {
+  if (jobs[i].done)
+    jobs_done--;
+
+  memmove(jobs + i, jobs + i + 1, (jobs_len - i - 1) * sizeof(struct job));
+  jobs_len--;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_add(..)
+// parameters : pid_t pid
+// description: Records a job just started with &
+// --------------------------------------------------------------- //
+void jobs_add(pid_t pid) {
+  if (jobs_len == jobs_cap) {
+    jobs_cap = jobs_cap ? jobs_cap * 2 : 16;
+    jobs = realloc(jobs, jobs_cap * sizeof(struct job));
+
+    if (!jobs) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+
+  jobs[jobs_len].pid = pid;
+  jobs[jobs_len].status = 0;
+  jobs[jobs_len].done = 0;
+  jobs_len++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_reaped(..)
+// parameters : pid_t pid
+//              int status
+// description: Stores the wait status of a reaped child. Returns 1 if
+//              it was a job, 0 for any other child
+// --------------------------------------------------------------- //
+int jobs_reaped(pid_t pid, int status) {
+  for (int i = 0; i < jobs_len; i++) {
+    if (jobs[i].pid != pid || jobs[i].done)
+      continue;
+
+    jobs[i].status = status;
+    jobs[i].done = ++done_seq;
+    jobs_done++;
+
+    if (jobs_done > JOBS_KEEP) {  // Nobody is collecting, drop the oldest
+      int dropped;
+      jobs_next_done(&dropped);
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_next_done(..)
+// parameters : int *status
+// description: Collects the job that finished first of those not yet
+//              collected. Returns its pid with its wait status in
+//              status, or 0 if none has finished
+// --------------------------------------------------------------- //
+pid_t jobs_next_done(int *status) {
+  int first = -1;
+
+  for (int i = 0; i < jobs_len; i++) {
+    if (jobs[i].done && (first == -1 || jobs[i].done < jobs[first].done))
+      first = i;
+  }
+
+  if (first == -1)
+    return 0;
+
+  pid_t pid = jobs[first].pid;
+  *status = jobs[first].status;
+  drop(first);
+
+  return pid;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_running()
+// parameters : none
+// description: Returns the number of jobs not reaped yet
+// --------------------------------------------------------------- //
+int jobs_running() {
+  return jobs_len - jobs_done;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_collect(..)
+// parameters : int *succeeded
+//              int *failed
+// description: Collects every finished job, counting those that
+//              exited 0 and those that failed or were killed
+// --------------------------------------------------------------- //
+void jobs_collect(int *succeeded, int *failed) {
+  *succeeded = *failed = 0;
+
+  for (int i = 0; i < jobs_len; ) {
+    if (!jobs[i].done) {
+      i++;
+      continue;
+    }
+
+    if (WIFEXITED(jobs[i].status) && WEXITSTATUS(jobs[i].status) == 0)
+      (*succeeded)++;
+    else
+      (*failed)++;
+
+    drop(i);
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_forget_running()
+// parameters : none
+// description: Drops jobs still marked running, after waitpid says
+//              there are no children left to wait for
+// --------------------------------------------------------------- //
+void jobs_forget_running() {
+  for (int i = 0; i < jobs_len; ) {
+    if (jobs[i].done)
+      i++;
+    else
+      drop(i);
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobs_clear()
+// parameters : none
+// description: Forgets every job, in a forked copy of the shell whose
+//              parent's jobs are not its children
+// --------------------------------------------------------------- //
+void jobs_clear() {
+  jobs_len = jobs_done = 0;
+}
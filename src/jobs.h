@@ -0,0 +1,25 @@
+// jobs.h
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <sys/types.h>
+
+
+// --------------------------------------------------------------- //
+// description: Background jobs and their exit statuses. A job's
+//              status is kept from when it is reaped until wait
+//              collects it, so wait -n can hand out completions in
+//              the order they happened
+// --------------------------------------------------------------- //
+#define JOBS_KEEP 4096  // Uncollected statuses kept, oldest dropped
+
+void  jobs_add(pid_t pid);
+int   jobs_reaped(pid_t pid, int status);
+pid_t jobs_next_done(int *status);
+int   jobs_running();
+void  jobs_collect(int *succeeded, int *failed);
+void  jobs_forget_running();
+void  jobs_clear();
+
+#endif
@@ -0,0 +1,428 @@
+// jobserver.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "src/jobserver.h"
+
+#define HOLDERS_MAX 256  // Jobs polled while waiting for a token
+
+
+// --------------------------------------------------------------- //
+// structure  : struct holder
+// description: A running & job and the token it holds. pidfd becomes
+//              readable when the job exits, which frees its token
+// --------------------------------------------------------------- //
+struct holder {
+  pid_t pid;
+  int   pidfd;
+  int   token;
+  int   prio;   // Job priority, see sched.h
+};
+
+static int read_fd = -1;   // Ours, non-blocking: a reopened pipe or the fifo
+static int write_fd = -1;
+static int implicit_used = 0;
+static struct holder* holders = NULL;
+static int holders_len = 0;
+static int holders_cap = 0;
+
+static unsigned long stat_tokens = 0;  // Taken from the jobserver
+static unsigned long stat_waits = 0;   // Times no token was free
+static long stat_wait_ns = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : reopen(..)
+// parameters : const char* path
+//              int flags
+// description: Opens path close-on-exec and non-blocking, for a fd of
+//              our own. Reopening an inherited pipe through /proc gives
+//              a new open file, so O_NONBLOCK doesn't reach make
+// --------------------------------------------------------------- //
+static int reopen(const char* path, int flags) {
+  return open(path, flags | O_NONBLOCK | O_CLOEXEC);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : is_pipe(..)
+// parameters : int fd
+// description: Returns 1 if fd is open and a pipe or fifo. make closes
+//              its jobserver fds for commands it doesn't count as
+//              recursive, so the numbers in MAKEFLAGS may be free, or
+//              reused by an unrelated file
+// --------------------------------------------------------------- //
+static int is_pipe(int fd) {
+  struct stat st;
+
+  return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : auth_value(..)
+// parameters : const char* flags
+// description: Returns the value of the last --jobserver-auth= (or
+//              older --jobserver-fds=) in MAKEFLAGS, copied, or NULL
+// --------------------------------------------------------------- //
+static char* auth_value(const char* flags) {
+  const char* names[] = { "--jobserver-auth=", "--jobserver-fds=" };
+  const char* last = NULL;
+
+  for (int n = 0; n < 2 && !last; n++) {
+    for (const char* p = flags; (p = strstr(p, names[n])); p += strlen(names[n]))
+      last = p + strlen(names[n]);
+  }
+
+  return last ? strndup(last, strcspn(last, " ")) : NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : join(..)
+// parameters : const char* auth
+// description: Opens the jobserver auth describes, fifo:PATH or R,W
+//              Returns -1 if it isn't there or isn't a pipe, as when
+//              make didn't pass the fds on to this command
+// --------------------------------------------------------------- //
+static int join(const char* auth) {
+  char path[64];
+  int r, w;
+
+  if (strncmp(auth, "fifo:", 5) == 0) {
+    read_fd = write_fd = reopen(auth + 5, O_RDWR);
+
+    if (read_fd != -1 && !is_pipe(read_fd)) {
+      close(read_fd);
+      read_fd = write_fd = -1;
+    }
+    return read_fd == -1 ? -1 : 0;
+  }
+
+  if (sscanf(auth, "%d,%d", &r, &w) != 2 || r < 0 || w < 0 || !is_pipe(r) || !is_pipe(w))
+    return -1;
+
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", r);
+  read_fd = reopen(path, O_RDONLY);
+
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", w);
+  write_fd = reopen(path, O_WRONLY);
+
+  if (read_fd == -1 || write_fd == -1) {
+    if (read_fd != -1)
+      close(read_fd);
+    read_fd = write_fd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : serve(..)
+// parameters : int jobs
+// description: Starts a jobserver of jobs slots: a pipe holding
+//              jobs - 1 tokens (the shell has the implicit one),
+//              announced to children through MAKEFLAGS
+// --------------------------------------------------------------- //
+static void serve(int jobs) {
+  int fds[2];
+  char flags[4096];
+  const char* old = getenv("MAKEFLAGS");
+
+  if (pipe(fds) == -1) {
+    perror("jobserver");
+    return;
+  }
+
+  // Inherited by children, and kept clear of exec N's 0-9
+  int r = fcntl(fds[0], F_DUPFD, 10);
+  int w = fcntl(fds[1], F_DUPFD, 10);
+  close(fds[0]);
+  close(fds[1]);
+
+  for (int i = 1; i < jobs; i++)
+    write(w, "+", 1);
+
+  snprintf(flags, sizeof(flags), "%s%s-j%d --jobserver-auth=%d,%d",
+           old ? old : "", old && old[0] ? " " : "", jobs, r, w);
+  setenv("MAKEFLAGS", flags, 1);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_init(..)
+// parameters : int jobs
+// description: Joins make's jobserver if MAKEFLAGS names one that is
+//              open to us. Otherwise, with jobs above 1 (--jobs),
+//              becomes the jobserver for the shell's own children
+// --------------------------------------------------------------- //
+void jobserver_init(int jobs) {
+  if (read_fd != -1)  // A forked copy of the shell keeps its parent's
+    return;
+
+  const char* flags = getenv("MAKEFLAGS");
+  char* auth = flags ? auth_value(flags) : NULL;
+  int joined = auth && join(auth) == 0;
+
+  if (!joined && jobs > 1) {  // None, or not usable: the one serve() appends wins
+    free(auth);
+    serve(jobs);
+    auth = auth_value(getenv("MAKEFLAGS"));
+    joined = auth && join(auth) == 0;
+  }
+
+  if (auth && !joined)
+    fprintf(stderr, "smallsh: jobserver %s unavailable, & jobs are not limited\n", auth);
+
+  free(auth);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : wait_token(..)
+// parameters : void (*reap)()
+// description: Sleeps until a token may be free: the jobserver has
+//              one to read, or one of our jobs exited, which reap()
+//              then collects, giving its token back
+// --------------------------------------------------------------- //
+static void wait_token(void (*reap)()) {
+  struct pollfd fds[HOLDERS_MAX + 1];
+  int n = 0;
+  int timeout = -1;
+
+  fds[n].fd = read_fd;
+  fds[n++].events = POLLIN;
+
+  for (int i = 0; i < holders_len; i++) {
+    if (holders[i].pidfd == -1 || n > HOLDERS_MAX) {
+      timeout = 100;  // Can't watch this one, look again now and then
+      continue;
+    }
+
+    fds[n].fd = holders[i].pidfd;
+    fds[n++].events = POLLIN;
+  }
+
+  poll(fds, n, timeout);
+  reap();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_try()
+// parameters : none
+// description: Takes a token without waiting: the implicit slot if
+//              free, else one read from the jobserver
+//              Returns JOBSERVER_BUSY if there is none right now, and
+//              JOBSERVER_NONE without a jobserver (or once it's gone)
+// --------------------------------------------------------------- //
+int jobserver_try() {
+  unsigned char c;
+
+  if (read_fd == -1)
+    return JOBSERVER_NONE;
+
+  if (!implicit_used) {
+    implicit_used = 1;
+    return JOBSERVER_IMPLICIT;
+  }
+
+  ssize_t n = read(read_fd, &c, 1);
+
+  if (n == 1) {
+    stat_tokens++;
+    return c;
+  }
+
+  if (n == -1 && (errno == EAGAIN || errno == EINTR))
+    return JOBSERVER_BUSY;
+
+  jobserver_detach(JOBSERVER_NONE);  // Jobserver gone, stop limiting
+  close(read_fd);
+  if (write_fd != read_fd)
+    close(write_fd);
+  read_fd = write_fd = -1;
+
+  return JOBSERVER_NONE;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_acquire(..)
+// parameters : void (*reap)()
+// description: Gets a token for a & job about to start, blocking
+//              until one is free. The first job takes the implicit
+//              slot. reap() collects exited jobs while waiting
+//              Returns the token for jobserver_started()
+// --------------------------------------------------------------- //
+int jobserver_acquire(void (*reap)()) {
+  struct timespec start, end;
+  int token;
+  int waited = 0;
+
+  while ((token = jobserver_try()) == JOBSERVER_BUSY) {
+    if (!waited) {
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      stat_waits++;
+      waited = 1;
+    }
+
+    wait_token(reap);
+  }
+
+  if (waited) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stat_wait_ns += (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
+  }
+
+  return token;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_give(..)
+// parameters : int token
+// description: Returns a token nobody here needs to the jobserver
+// --------------------------------------------------------------- //
+void jobserver_give(int token) {
+  if (token == JOBSERVER_IMPLICIT) {
+    implicit_used = 0;
+  } else if (token >= 0 && write_fd != -1) {
+    unsigned char c = token;
+    while (write(write_fd, &c, 1) == -1 && errno == EINTR)
+      ;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_started(..)
+// parameters : pid_t pid
+//              int token
+//              int prio
+// description: Records that job pid, of priority prio, holds token
+//              until it is reaped
+// --------------------------------------------------------------- //
+void jobserver_started(pid_t pid, int token, int prio) {
+  if (token < 0)
+    return;
+
+  if (holders_len == holders_cap) {
+    holders_cap = holders_cap ? holders_cap * 2 : 16;
+    holders = realloc(holders, holders_cap * sizeof(struct holder));
+
+    if (!holders) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+
+  holders[holders_len].pid = pid;
+  holders[holders_len].pidfd = syscall(SYS_pidfd_open, pid, 0);  // -1 before Linux 5.3
+  holders[holders_len].token = token;
+  holders[holders_len].prio = prio;
+  holders_len++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : drop_holder(..)
+// parameters : int i
+// description: Forgets holder i. Returns the token it held
+// --------------------------------------------------------------- //
+static int drop_holder(int i) {
+  int token = holders[i].token;
+
+  if (holders[i].pidfd != -1)
+    close(holders[i].pidfd);
+
+  holders[i] = holders[--holders_len];
+  return token;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_release(..)
+// parameters : pid_t pid
+// description: Takes back the token of a reaped job, for the caller
+//              to hand on or give back. JOBSERVER_NONE if it had none
+// --------------------------------------------------------------- //
+int jobserver_release(pid_t pid) {
+  for (int i = 0; i < holders_len; i++) {
+    if (holders[i].pid == pid)
+      return drop_holder(i);
+  }
+
+  return JOBSERVER_NONE;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_take_from(..)
+// parameters : int prio
+//              int *token
+// description: Takes the token of the latest started job of priority
+//              prio, for a job that should run instead of it
+//              Returns the job's pid, or 0 if there is none
+// --------------------------------------------------------------- //
+pid_t jobserver_take_from(int prio, int *token) {
+  for (int i = holders_len - 1; i >= 0; i--) {
+    if (holders[i].prio != prio)
+      continue;
+
+    pid_t pid = holders[i].pid;
+    *token = drop_holder(i);
+    return pid;
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_detach(..)
+// parameters : int token
+// description: Forgets the tokens held by jobs, in a forked copy of
+//              the shell (those jobs aren't its children) or once the
+//              jobserver is gone. token is the one the parent took
+//              for the copy, a & job: that is the copy's implicit
+//              slot. A copy the parent took none for (JOBSERVER_NONE)
+//              shares the parent's slot, and keeps its accounting
+// --------------------------------------------------------------- //
+void jobserver_detach(int token) {
+  for (int i = 0; i < holders_len; i++) {
+    if (holders[i].pidfd != -1)
+      close(holders[i].pidfd);
+  }
+
+  holders_len = 0;
+
+  if (token != JOBSERVER_NONE)
+    implicit_used = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : jobserver_print_stats()
+// parameters : none
+// description: Prints the jobserver counters (stats), nothing if the
+//              shell isn't using one
+// --------------------------------------------------------------- //
+void jobserver_print_stats() {
+  if (read_fd == -1)
+    return;
+
+  printf("jobserver: %lu tokens taken, %d held, %lu waits, %.1f ms waiting\n",
+         stat_tokens, holders_len, stat_waits, stat_wait_ns / 1e6);
+  fflush(stdout);
+}
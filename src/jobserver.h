@@ -0,0 +1,30 @@
+// jobserver.h
+
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <sys/types.h>
+
+
+// --------------------------------------------------------------- //
+// description: GNU make jobserver. Under make -j, every & job takes
+//              a token from make's pipe or fifo (named in MAKEFLAGS)
+//              and gives it back when reaped, so the shell and make
+//              share one limit. With --jobs N and no make above, the
+//              shell starts a jobserver of N slots for its children
+// --------------------------------------------------------------- //
+#define JOBSERVER_NONE     -1   // No jobserver, nothing to give back
+#define JOBSERVER_BUSY     -2   // No token free right now
+#define JOBSERVER_IMPLICIT 256  // The slot every client has for free
+
+void  jobserver_init(int jobs);
+int   jobserver_try();
+int   jobserver_acquire(void (*reap)());
+void  jobserver_give(int token);
+void  jobserver_started(pid_t pid, int token, int prio);
+int   jobserver_release(pid_t pid);
+pid_t jobserver_take_from(int prio, int *token);
+void  jobserver_detach(int token);
+void  jobserver_print_stats();
+
+#endif
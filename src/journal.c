@@ -0,0 +1,418 @@
+// journal.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "src/journal.h"
+
+// Group commit: records are written as each command finishes so they
+// survive the shell being killed, but only forced to disk once this
+// many are pending or the last fdatasync is older than the interval.
+// A power loss can lose at most that window, and those commands rerun.
+#define JOURNAL_BATCH    256
+#define JOURNAL_SYNC_NS  50000000L  // 50 ms
+
+#define JOURNAL_NONE     INT_MIN    // journal_status of an index not completed
+
+static int   journal_fd = -1;
+static long  journal_done = 0;      // highest index completed by earlier runs
+static int*  journal_status = NULL; // exit status per index, JOURNAL_NONE if not completed
+static long  journal_cap = 0;
+static int   journal_pending = 0;   // records written since last fdatasync
+static struct timespec journal_synced;
+static long  journal_line = 0;      // index of the command running now
+
+
+// --------------------------------------------------------------- //
+// structure  : struct journal_wait
+// description: A command whose & jobs are still queued or running
+//              Its record is held back until the last one is reaped,
+//              so a resumed run doesn't skip a job that never finished
+// --------------------------------------------------------------- //
+struct journal_wait {
+  long index;
+  int  jobs;    // Admitted and not yet reaped
+  int  ended;   // The command itself has finished, with status
+  int  status;
+};
+
+// --------------------------------------------------------------- //
+// structure  : struct journal_job
+// description: A running & job and the command that started it
+// --------------------------------------------------------------- //
+struct journal_job {
+  pid_t pid;
+  long  index;
+};
+
+static struct journal_wait* waits = NULL;
+static int waits_len = 0;
+static int waits_cap = 0;
+
+static struct journal_job* jobs = NULL;
+static int jobs_len = 0;
+static int jobs_cap = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : journal_header(..)
+// parameters : char* buf
+//              size_t len
+//              char* script
+// description: Writes the header identifying the script the journal
+//              belongs to. A resumed run only trusts a journal whose
+//              header matches the script's current size and mtime
+// --------------------------------------------------------------- //
+static void journal_header(char* buf, size_t len, char* script) {
+  struct stat st = { 0 };
+  stat(script, &st);
+  snprintf(buf, len, "smallsh-journal 1 %lld %lld\n",
+           (long long) st.st_size, (long long) st.st_mtime);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_keep(..)
+// parameters : long index
+//              int exit_status
+// description: Remembers a completed command loaded from the journal
+// --------------------------------------------------------------- //
+static void journal_keep(long index, int exit_status) {
+  if (index >= journal_cap) {
+    long cap = journal_cap ? journal_cap : 1024;
+    while (cap <= index)
+      cap *= 2;
+
+    journal_status = realloc(journal_status, cap * sizeof(int));
+    for (long i = journal_cap; i < cap; i++)
+      journal_status[i] = JOURNAL_NONE;
+    journal_cap = cap;
+  }
+
+  journal_status[index] = exit_status;
+  if (index > journal_done)
+    journal_done = index;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_load(..)
+// parameters : char* path
+//              char* header
+// description: Reads records of a previous run. Returns the offset
+//              just past the last complete record, or -1 if the
+//              journal is missing or was written for another script
+// --------------------------------------------------------------- //
+static long journal_load(char* path, char* header) {
+  char buf[256];
+  FILE* fp = fopen(path, "r");
+
+  if (!fp)
+    return -1;
+
+  if (!fgets(buf, sizeof(buf), fp) || strcmp(buf, header) != 0) {
+    fprintf(stderr, "journal %s does not match script, starting over\n", path);
+    fclose(fp);
+    return -1;
+  }
+
+  long end = ftell(fp);
+  long index;
+  int exit_status;
+
+  // A record torn by the crash has no newline and is dropped
+  while (fgets(buf, sizeof(buf), fp) && strchr(buf, '\n')) {
+    if (sscanf(buf, "%ld %d", &index, &exit_status) != 2)
+      break;
+
+    journal_keep(index, exit_status);
+    end = ftell(fp);
+  }
+
+  fclose(fp);
+  return end;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_open(..)
+// parameters : char* path
+//              char* script
+//              int resume
+// description: Opens the journal for script. With resume, loads the
+//              commands a previous run completed; otherwise starts
+//              a fresh journal
+// --------------------------------------------------------------- //
+void journal_open(char* path, char* script, int resume) {
+  char header[128];
+  long end = -1;
+
+  journal_header(header, sizeof(header), script);
+
+  if (resume)
+    end = journal_load(path, header);
+
+  journal_fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+
+  if (journal_fd == -1) {
+    perror("Journal could not be opened");
+    exit(1);
+  }
+
+  if (end == -1) {  // Fresh journal
+    journal_done = 0;
+    if (ftruncate(journal_fd, 0) == -1 || write(journal_fd, header, strlen(header)) == -1) {
+      perror("Journal could not be written");
+      exit(1);
+    }
+    end = strlen(header);
+
+  } else if (ftruncate(journal_fd, end) == -1) {  // Drop any torn record
+    perror("Journal could not be truncated");
+    exit(1);
+  }
+
+  lseek(journal_fd, end, SEEK_SET);
+  clock_gettime(CLOCK_MONOTONIC, &journal_synced);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_completed(..)
+// parameters : long index
+//              int *exit_status
+// description: Returns 1 and the recorded exit status if command
+//              index was completed by a previous run. Also marks it
+//              as the command running now, see journal_job()
+//              Records can be out of order (a command with & jobs is
+//              recorded when they are reaped), so each index is
+//              looked up on its own
+// --------------------------------------------------------------- //
+int journal_completed(long index, int *exit_status) {
+  journal_line = index;
+
+  if (journal_fd == -1 || index > journal_done || journal_status[index] == JOURNAL_NONE)
+    return 0;
+
+  *exit_status = journal_status[index];
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_sync()
+// parameters : none
+// description: Forces written records to disk
+// --------------------------------------------------------------- //
+static void journal_sync() {
+  fdatasync(journal_fd);
+  journal_pending = 0;
+  clock_gettime(CLOCK_MONOTONIC, &journal_synced);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : write_record(..)
+// parameters : long index
+//              int exit_status
+// description: Appends a record, syncing a batch of them now and then
+// --------------------------------------------------------------- //
+static void write_record(long index, int exit_status) {
+  char buf[48];
+  struct timespec now;
+
+  int len = snprintf(buf, sizeof(buf), "%ld %d\n", index, exit_status);
+  if (write(journal_fd, buf, len) != len) {
+    perror("Journal could not be written");
+    return;
+  }
+
+  journal_pending++;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  long elapsed = (now.tv_sec - journal_synced.tv_sec) * 1000000000L
+               + (now.tv_nsec - journal_synced.tv_nsec);
+
+  if (journal_pending >= JOURNAL_BATCH || elapsed >= JOURNAL_SYNC_NS)
+    journal_sync();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : find_wait(..)
+// parameters : long index
+// description: Returns the held back record of command index, or NULL
+// --------------------------------------------------------------- //
+static struct journal_wait* find_wait(long index) {
+  for (int i = 0; i < waits_len; i++) {
+    if (waits[i].index == index)
+      return &waits[i];
+  }
+
+  return NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_record(..)
+// parameters : long index
+//              int exit_status
+// description: Records a finished command. Commands a previous run
+//              already recorded are not written again. If & jobs it
+//              started are still queued or running, the record waits
+//              for journal_job_done() to reap the last of them
+// --------------------------------------------------------------- //
+void journal_record(long index, int exit_status) {
+  int ignored;
+
+  if (journal_fd == -1 || journal_completed(index, &ignored))
+    return;
+
+  struct journal_wait* w = find_wait(index);
+
+  if (w && w->jobs) {
+    w->ended = 1;
+    w->status = exit_status;
+    return;
+  }
+
+  if (w)  // Its jobs were all reaped already
+    *w = waits[--waits_len];
+
+  write_record(index, exit_status);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_job()
+// parameters : none
+// description: Counts a & job admitted by the command running now
+//              Returns that command's index, for journal_job_started()
+//              once the job, which may be queued first, has a pid
+// --------------------------------------------------------------- //
+long journal_job() {
+  if (journal_fd == -1 || journal_line <= 0)
+    return 0;
+
+  struct journal_wait* w = find_wait(journal_line);
+
+  if (!w) {
+    if (waits_len == waits_cap) {
+      waits_cap = waits_cap ? waits_cap * 2 : 16;
+      waits = realloc(waits, waits_cap * sizeof(*waits));
+    }
+
+    w = &waits[waits_len++];
+    w->index = journal_line;
+    w->jobs = 0;
+    w->ended = 0;
+  }
+
+  w->jobs++;
+  return journal_line;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_job_started(..)
+// parameters : long index
+//              pid_t pid
+// description: Notes the pid of a & job journal_job() counted for
+//              command index
+// --------------------------------------------------------------- //
+void journal_job_started(long index, pid_t pid) {
+  if (journal_fd == -1 || index <= 0)
+    return;
+
+  if (jobs_len == jobs_cap) {
+    jobs_cap = jobs_cap ? jobs_cap * 2 : 16;
+    jobs = realloc(jobs, jobs_cap * sizeof(*jobs));
+  }
+
+  jobs[jobs_len].pid = pid;
+  jobs[jobs_len].index = index;
+  jobs_len++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_job_done(..)
+// parameters : pid_t pid
+// description: A & job was reaped. When it was the last one of its
+//              command and the command has finished, the command's
+//              held back record is written
+// --------------------------------------------------------------- //
+void journal_job_done(pid_t pid) {
+  for (int i = 0; i < jobs_len; i++) {
+    if (jobs[i].pid != pid)
+      continue;
+
+    struct journal_wait* w = find_wait(jobs[i].index);
+
+    jobs[i] = jobs[--jobs_len];
+
+    if (w && --w->jobs == 0 && w->ended) {
+      long index = w->index;
+      int status = w->status;
+
+      *w = waits[--waits_len];
+      write_record(index, status);
+    }
+    return;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_close()
+// parameters : none
+// description: Syncs outstanding records and closes the journal
+// --------------------------------------------------------------- //
+void journal_close() {
+  if (journal_fd == -1)
+    return;
+
+  if (journal_pending)
+    journal_sync();
+
+  close(journal_fd);
+  journal_fd = -1;
+  free(journal_status);
+  journal_status = NULL;
+  journal_cap = 0;
+
+  free(waits);  // Commands whose jobs are still running stay unrecorded
+  waits = NULL;
+  waits_len = waits_cap = 0;
+  free(jobs);
+  jobs = NULL;
+  jobs_len = jobs_cap = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : journal_detach()
+// parameters : none
+// description: Forgets the journal without syncing or writing to it
+//              Used in a forked copy of the shell, which must leave
+//              the parent's records alone
+// --------------------------------------------------------------- //
+void journal_detach() {
+  if (journal_fd != -1)
+    close(journal_fd);
+
+  journal_fd = -1;
+  journal_done = 0;
+  journal_pending = 0;
+  journal_line = 0;
+  waits_len = 0;
+  jobs_len = 0;
+  free(journal_status);
+  journal_status = NULL;
+  journal_cap = 0;
+}
@@ -0,0 +1,23 @@
+// journal.h
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <sys/types.h>
+
+// --------------------------------------------------------------- //
+// description: Journal of completed script commands so a script that
+//              died midway can be resumed with --resume. Commands are
+//              identified by their line index in the script. A command
+//              that started & jobs is recorded once they are reaped
+// --------------------------------------------------------------- //
+void journal_open(char* path, char* script, int resume);
+int  journal_completed(long index, int *exit_status);
+void journal_record(long index, int exit_status);
+long journal_job();
+void journal_job_started(long index, pid_t pid);
+void journal_job_done(pid_t pid);
+void journal_close();
+void journal_detach();
+
+#endif
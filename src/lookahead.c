@@ -0,0 +1,187 @@
+// lookahead.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "src/lookahead.h"
+#include "src/builtins.h"
+#include "src/dirs.h"
+#include "src/exec_cache.h"
+#include "src/reader.h"
+
+#define LOOKAHEAD_MAX  64  // Deepest lookahead allowed
+#define RECENT         32  // Files prefetched lately, not advised again
+
+// --------------------------------------------------------------- //
+// structure  : struct ahead_line
+// description: A script line read ahead of execution
+// --------------------------------------------------------------- //
+struct ahead_line {
+  struct cmd_desc* cmd;
+  int   warmed;  // Its files were prefetched
+};
+
+static int   depth = 0;
+static struct ahead_line queue[LOOKAHEAD_MAX];
+static int   head = 0;   // Next line to hand out
+static int   count = 0;  // Lines queued
+
+static char* recent[RECENT];  // Ring of recently prefetched paths
+static int   recent_next = 0;
+
+// Counters for 'stats'
+static unsigned long stat_lines = 0;     // Lines looked at ahead of time
+static unsigned long stat_issued = 0;    // Files advised WILLNEED
+static unsigned long stat_repeat = 0;    // Skipped, prefetched lately
+static unsigned long stat_used = 0;      // Warmed lines that then ran
+
+
+// --------------------------------------------------------------- //
+// function   : lookahead_init(..)
+// parameters : int lines
+// description: Looks up to lines ahead in the script being read by
+//              reader_next() (0 turns lookahead off)
+// --------------------------------------------------------------- //
+void lookahead_init(int lines) {
+  depth = lines > LOOKAHEAD_MAX ? LOOKAHEAD_MAX : lines;
+  head = count = 0;  // A forked copy of the shell starts over
+  stat_lines = stat_issued = stat_repeat = stat_used = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : lookahead_next()
+// parameters : none
+// description: Returns the next script line (caller frees it), from
+//              the lookahead queue when there is one
+// --------------------------------------------------------------- //
+struct cmd_desc* lookahead_next() {
+  if (!count)
+    return reader_next(1);
+
+  struct ahead_line* a = &queue[head];
+  struct cmd_desc* cmd = a->cmd;
+
+  if (a->warmed)
+    stat_used++;
+
+  a->cmd = NULL;
+  head = (head + 1) % LOOKAHEAD_MAX;
+  count--;
+
+  return cmd;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : warm(..)
+// parameters : const char* path
+// description: Asks the kernel to read path into the page cache in
+//              the background, unless that was done lately
+//              Only regular files are advised. The open doesn't block,
+//              so a < from a FIFO or a device is looked at and left
+// --------------------------------------------------------------- //
+static void warm(const char* path) {
+  for (int i = 0; i < RECENT; i++) {
+    if (recent[i] && strcmp(recent[i], path) == 0) {
+      stat_repeat++;
+      return;
+    }
+  }
+
+  struct stat st;
+  int fd = dir_open(path, O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC, 0);
+  if (fd == -1)
+    return;
+
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return;
+  }
+
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);  // Starts async readahead
+  close(fd);
+  stat_issued++;
+
+  free(recent[recent_next]);
+  recent[recent_next] = strdup(path);
+  recent_next = (recent_next + 1) % RECENT;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : warm_line(..)
+// parameters : struct cmd_desc* cmd
+// description: Prefetches the binary and < file of one script line
+//              Returns 1 if anything was prefetched. Builtins, aliases
+//              and functions have no binary of their own
+// --------------------------------------------------------------- //
+static int warm_line(struct cmd_desc* cmd) {
+  char** words = cmd->tokens;
+  struct exec_target t;
+
+  if (!words[0] || words[0][0] == '#' || find_builtin(words[0]))
+    return 0;
+
+  exec_lookup(words[0], &t);  // Also fills the exec cache for later
+  if (t.path)
+    warm(t.path);
+
+  for (int i = 1; words[i]; i++) {
+    if (strcmp(words[i], "<") == 0 && words[i + 1]) {
+      warm(words[i + 1]);
+      break;
+    }
+  }
+
+  return t.path != NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : lookahead_prefetch()
+// parameters : none
+// description: Called while the shell waits on a foreground command
+//              Fills the queue up to the lookahead depth and prefetches
+//              lines not yet looked at. Never waits on the parser
+//              thread: the foreground command may already be done
+// --------------------------------------------------------------- //
+void lookahead_prefetch() {
+  while (count < depth) {
+    struct cmd_desc* cmd = reader_next(0);  // Only lines already parsed
+
+    if (!cmd)
+      break;
+
+    struct ahead_line* a = &queue[(head + count) % LOOKAHEAD_MAX];
+    a->cmd = cmd;
+    a->warmed = warm_line(cmd);
+    count++;
+    stat_lines++;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : lookahead_print_stats()
+// parameters : none
+// description: Prints the lookahead counters (stats)
+// --------------------------------------------------------------- //
+void lookahead_print_stats() {
+  unsigned long pending = 0;
+
+  if (!depth)  // Off, or not running a script
+    return;
+
+  for (int i = 0; i < count; i++)  // Queued now, not run yet
+    pending += queue[(head + i) % LOOKAHEAD_MAX].warmed;
+
+  printf("lookahead: depth %d, %lu lines read ahead, %lu files prefetched, "
+         "%lu skipped as prefetched lately, %lu prefetched commands run, %lu pending\n",
+         depth, stat_lines, stat_issued, stat_repeat, stat_used, pending);
+  fflush(stdout);
+}
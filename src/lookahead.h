@@ -0,0 +1,21 @@
+// lookahead.h
+
+#ifndef LOOKAHEAD_H
+#define LOOKAHEAD_H
+
+#include "src/reader.h"
+
+
+// --------------------------------------------------------------- //
+// description: Script lookahead. While a foreground command runs,
+//              the shell reads the next few script lines, finds their
+//              binaries and < input files and asks the kernel to start
+//              reading them into the page cache, so they are warm by
+//              the time those commands run
+// --------------------------------------------------------------- //
+void  lookahead_init(int depth);
+struct cmd_desc* lookahead_next();
+void  lookahead_prefetch();
+void  lookahead_print_stats();
+
+#endif
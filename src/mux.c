@@ -0,0 +1,418 @@
+// mux.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include "src/mux.h"
+
+#define EVENTS     64    // Ready pipes taken per epoll_wait()
+#define READ_MIN   4096  // Room made in a buffer before reading
+#define DRAIN_MAX  64    // Rounds of leftover output read at exit
+
+
+// --------------------------------------------------------------- //
+// structure  : struct job
+// description: The read end of a job's pipe and what came out of it
+//              that isn't a complete line yet. Owned by the thread
+// --------------------------------------------------------------- //
+struct job {
+  int         fd;
+  char        prefix[24];  // "[pid] "
+  int         prefix_len;
+  char*       buf;
+  size_t      len;
+  size_t      cap;
+  size_t      used;        // Bytes written out, dropped after the flush
+  int         closed;
+  struct job* next;
+};
+
+static int active = 0;
+static int out_fd = -1;    // The terminal, kept apart from redirections of fd 1
+static int epoll_fd = -1;
+static int ctl[2] = { -1, -1 };  // New jobs, NULL to finish
+static pthread_t thread;
+static struct job* jobs = NULL;
+
+static struct iovec batch[IOV_MAX];
+static int batch_len = 0;
+static char newline = '\n';
+
+// Counters for 'stats', written by the thread
+static _Atomic unsigned long stat_jobs;
+static _Atomic unsigned long stat_lines;
+static _Atomic unsigned long stat_bytes;
+static _Atomic unsigned long stat_writes;
+
+
+// --------------------------------------------------------------- //
+// function   : high(..)
+// parameters : int fd
+// description: Moves fd clear of exec N's 0-9, close-on-exec
+//              Returns the new fd, or -1
+// --------------------------------------------------------------- //
+static int high(int fd) {
+  int moved = fd == -1 ? -1 : fcntl(fd, F_DUPFD_CLOEXEC, 10);
+
+  if (fd != -1)
+    close(fd);
+  return moved;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : flush()
+// parameters : none
+// description: Writes the batched lines with as few writev() calls as
+//              the terminal takes. Output nobody can see is dropped
+// --------------------------------------------------------------- //
+static void flush() {
+  struct iovec* v = batch;
+  int n = batch_len;
+
+  while (n > 0) {
+    ssize_t w = writev(out_fd, v, n);
+
+    if (w == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    stat_bytes += w;
+    stat_writes++;
+
+    while (n > 0 && (size_t)w >= v->iov_len) {
+      w -= v->iov_len;
+      v++;
+      n--;
+    }
+
+    if (n > 0) {  // Partly written
+      v->iov_base = (char*)v->iov_base + w;
+      v->iov_len -= w;
+    }
+  }
+
+  batch_len = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : emit(..)
+// parameters : struct job *job
+//              char* line
+//              size_t len
+//              int end
+// description: Adds a line to the batch behind the job's prefix, with
+//              a newline if end is set (it had none)
+// --------------------------------------------------------------- //
+static void emit(struct job *job, char* line, size_t len, int end) {
+  if (batch_len + 3 > IOV_MAX)
+    flush();
+
+  batch[batch_len].iov_base = job->prefix;
+  batch[batch_len++].iov_len = job->prefix_len;
+  batch[batch_len].iov_base = line;
+  batch[batch_len++].iov_len = len;
+
+  if (end) {
+    batch[batch_len].iov_base = &newline;
+    batch[batch_len++].iov_len = 1;
+  }
+
+  stat_lines++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : take_lines(..)
+// parameters : struct job *job
+//              int all
+// description: Batches the complete lines in the job's buffer. What
+//              follows the last newline waits for more, unless it has
+//              reached MUX_LINE_MAX or all is set (end of output)
+// --------------------------------------------------------------- //
+static void take_lines(struct job *job, int all) {
+  size_t start = job->used;
+  char* nl;
+
+  if (!job->buf)  // Nothing read yet
+    return;
+
+  while ((nl = memchr(job->buf + start, '\n', job->len - start))) {
+    size_t end = nl - job->buf + 1;
+
+    emit(job, job->buf + start, end - start, 0);
+    start = end;
+  }
+
+  if (job->len > start && (all || job->len - start >= MUX_LINE_MAX)) {
+    emit(job, job->buf + start, job->len - start, 1);
+    start = job->len;
+  }
+
+  job->used = start;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : read_job(..)
+// parameters : struct job *job
+// description: Reads what the job wrote and batches its lines. At end
+//              of output the rest goes too and the pipe is closed
+// --------------------------------------------------------------- //
+static void read_job(struct job *job) {
+  if (job->cap - job->len < READ_MIN) {
+    job->cap = job->cap ? job->cap * 2 : 2 * READ_MIN;
+    job->buf = realloc(job->buf, job->cap);
+
+    if (!job->buf) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+
+  ssize_t n = read(job->fd, job->buf + job->len, job->cap - job->len);
+
+  if (n > 0) {
+    job->len += n;
+    take_lines(job, 0);
+  } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+    take_lines(job, 1);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, job->fd, NULL);
+    close(job->fd);
+    job->closed = 1;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : settle()
+// parameters : none
+// description: After a flush, drops the lines written from each
+//              buffer and frees the jobs whose output ended
+// --------------------------------------------------------------- //
+static void settle() {
+  for (struct job** p = &jobs; *p;) {
+    struct job* job = *p;
+
+    if (job->closed) {
+      *p = job->next;
+      free(job->buf);
+      free(job);
+      continue;
+    }
+
+    if (job->used) {
+      memmove(job->buf, job->buf + job->used, job->len - job->used);
+      job->len -= job->used;
+      job->used = 0;
+    }
+    p = &job->next;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : take_new()
+// parameters : none
+// description: Starts watching jobs sent by mux_add()
+//              Returns 1 once mux_finish() asked to stop
+// --------------------------------------------------------------- //
+static int take_new() {
+  struct job* job;
+
+  while (read(ctl[0], &job, sizeof(job)) == sizeof(job)) {
+    if (!job)
+      return 1;
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = job };
+
+    job->next = jobs;
+    jobs = job;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, job->fd, &ev);
+    stat_jobs++;
+  }
+
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_stage(..)
+// parameters : void* unused
+// description: The thread: waits for job output and writes it out a
+//              round of ready pipes at a time. When asked to finish,
+//              reads what is left in the pipes without waiting for
+//              jobs still running, and ends their last lines
+// --------------------------------------------------------------- //
+static void* mux_stage(void* unused) {
+  struct epoll_event ev[EVENTS];
+  int finishing = 0;
+  int rounds = 0;
+
+  while (!finishing || rounds++ < DRAIN_MAX) {
+    int n = epoll_wait(epoll_fd, ev, EVENTS, finishing ? 0 : -1);
+
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+
+    for (int i = 0; i < n; i++) {
+      if (ev[i].data.ptr)
+        read_job(ev[i].data.ptr);
+      else if (take_new())
+        finishing = 1;
+    }
+
+    flush();
+    settle();
+  }
+
+  for (struct job* job = jobs; job; job = job->next) {
+    take_lines(job, 1);
+    close(job->fd);
+    job->closed = 1;
+  }
+
+  flush();
+  settle();
+
+  return NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_init()
+// parameters : none
+// description: Starts the thread for --prefix-output. It blocks all
+//              signals, so they still reach the main thread
+//              Returns -1 if it can't, & jobs then write to /dev/null
+// --------------------------------------------------------------- //
+int mux_init() {
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+  sigset_t all, old;
+
+  out_fd = high(dup(1));
+  epoll_fd = high(epoll_create1(EPOLL_CLOEXEC));
+
+  if (out_fd == -1 || epoll_fd == -1 || pipe2(ctl, O_CLOEXEC | O_NONBLOCK) == -1) {
+    perror("smallsh: --prefix-output");
+    return -1;
+  }
+
+  ctl[0] = high(ctl[0]);
+  ctl[1] = high(ctl[1]);
+  fcntl(ctl[1], F_SETFL, 0);  // The shell waits rather than lose a job
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ctl[0], &ev);
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);  // Inherited by the thread
+  active = pthread_create(&thread, NULL, mux_stage, NULL) == 0;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (!active)
+    fprintf(stderr, "smallsh: --prefix-output: no thread\n");
+
+  return active ? 0 : -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_pipe(..)
+// parameters : int *read_fd
+// description: Makes the pipe for a & job about to be forked. The
+//              child writes to the returned end; the parent hands
+//              *read_fd to mux_add() and closes the other
+//              Returns -1 when output isn't prefixed
+// --------------------------------------------------------------- //
+int mux_pipe(int *read_fd) {
+  int fds[2];
+
+  if (!active || pipe2(fds, O_CLOEXEC) == -1)
+    return -1;
+
+  *read_fd = high(fds[0]);
+  return high(fds[1]);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_add(..)
+// parameters : int read_fd
+//              pid_t pid
+// description: Hands the pipe of job pid to the thread
+// --------------------------------------------------------------- //
+void mux_add(int read_fd, pid_t pid) {
+  struct job* job = calloc(1, sizeof(struct job));
+
+  if (!job) {
+    perror("calloc");
+    exit(1);
+  }
+
+  job->fd = read_fd;
+  job->prefix_len = snprintf(job->prefix, sizeof(job->prefix), "[%d] ", pid);
+
+  while (write(ctl[1], &job, sizeof(job)) == -1 && errno == EINTR)
+    ;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_detach()
+// parameters : none
+// description: In a forked copy of the shell, which has no thread,
+//              lets its own & jobs write to /dev/null again
+// --------------------------------------------------------------- //
+void mux_detach() {
+  active = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_finish()
+// parameters : none
+// description: Writes out what jobs have left in their pipes and
+//              stops the thread. Jobs still running lose their pipe
+// --------------------------------------------------------------- //
+void mux_finish() {
+  struct job* stop = NULL;
+
+  if (!active)
+    return;
+
+  while (write(ctl[1], &stop, sizeof(stop)) == -1 && errno == EINTR)
+    ;
+  pthread_join(thread, NULL);
+  active = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : mux_print_stats()
+// parameters : none
+// description: Prints the output counters (stats), nothing without
+//              --prefix-output
+// --------------------------------------------------------------- //
+void mux_print_stats() {
+  if (!active)
+    return;
+
+  printf("mux: %lu jobs, %lu lines, %lu bytes in %lu writes\n",
+         (unsigned long)stat_jobs, (unsigned long)stat_lines,
+         (unsigned long)stat_bytes, (unsigned long)stat_writes);
+  fflush(stdout);
+}
@@ -0,0 +1,26 @@
+// mux.h
+
+#ifndef MUX_H
+#define MUX_H
+
+#include <sys/types.h>
+
+
+// --------------------------------------------------------------- //
+// description: Prefixed output for & jobs (--prefix-output). Each
+//              job writes its stdout and stderr into a pipe of its
+//              own; a thread collects complete lines per job and
+//              writes them to the terminal as "[pid] line", batching
+//              the lines of every ready job into one writev(), so
+//              lines of concurrent jobs never mix
+// --------------------------------------------------------------- //
+#define MUX_LINE_MAX 65536  // A longer line is written in pieces
+
+int  mux_init();
+int  mux_pipe(int *read_fd);
+void mux_add(int read_fd, pid_t pid);
+void mux_detach();
+void mux_finish();
+void mux_print_stats();
+
+#endif
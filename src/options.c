@@ -0,0 +1,157 @@
+// options.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "src/options.h"
+
+
+// --------------------------------------------------------------- //
+// function   : usage(..)
+// parameters : char* prog
+// description: Prints command line usage and exits with status 2
+// --------------------------------------------------------------- //
+static void usage(char* prog) {
+  fprintf(stderr, "usage: %s [--quiet] [--norc | --rc file] [--redirect-beneath] "
+                  "[--lookahead lines] [--pipeline] [--no-cache] [--jobs n] [--pressure limits] "
+                  "[--spawn-rate rate[:burst]] [--init] [--prefix-output] "
+                  "[--startup-bench [runs]] [--journal file | --resume file] [script]\n", prog);
+  exit(2);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : default_rc()
+// parameters : none
+// description: Returns the startup file used without --rc: the one
+//              named by SMALLSH_RC, or ~/.smallshrc
+// --------------------------------------------------------------- //
+static char* default_rc() {
+  static char path[4096];
+  char* env = getenv("SMALLSH_RC");
+  char* home = getenv("HOME");
+
+  if (env)
+    return env[0] ? env : NULL;  // Set but empty turns it off
+
+  if (!home || !home[0])
+    return NULL;
+
+  snprintf(path, sizeof(path), "%s/.smallshrc", home);
+  return path;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_options(..)
+// parameters : int argc
+//              char* argv[]
+//              struct shell_options *opts
+// description: Fills opts from the command line. The first argument
+//              that is not an option is the script to run
+// example    : smallsh --resume build.journal build.sh
+// --------------------------------------------------------------- //
+void parse_options(int argc, char* argv[], struct shell_options *opts) {
+  int norc = 0;
+
+  memset(opts, 0, sizeof(*opts));
+  opts->lookahead = 8;
+  opts->cache = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--journal") == 0 || strcmp(argv[i], "--resume") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+
+      opts->resume = (strcmp(argv[i], "--resume") == 0);
+      opts->journal = argv[++i];
+
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      opts->quiet = 1;
+
+    } else if (strcmp(argv[i], "--norc") == 0) {
+      norc = 1;
+
+    } else if (strcmp(argv[i], "--rc") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+
+      opts->rc = argv[++i];
+
+    } else if (strcmp(argv[i], "--version") == 0) {
+      printf("smallsh %s\n", SMALLSH_VERSION);
+      exit(0);
+
+    } else if (strcmp(argv[i], "--redirect-beneath") == 0) {
+      opts->beneath = 1;
+
+    } else if (strcmp(argv[i], "--lookahead") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+
+      opts->lookahead = atoi(argv[++i]);
+
+    } else if (strcmp(argv[i], "--pipeline") == 0) {
+      opts->pipeline = 1;
+
+    } else if (strcmp(argv[i], "--no-cache") == 0) {
+      opts->cache = 0;
+
+    } else if (strcmp(argv[i], "--jobs") == 0) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) < 1)
+        usage(argv[0]);
+
+      opts->jobs = atoi(argv[++i]);
+
+    } else if (strcmp(argv[i], "--pressure") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+
+      opts->pressure = argv[++i];
+
+    } else if (strcmp(argv[i], "--spawn-rate") == 0) {
+      if (i + 1 >= argc)
+        usage(argv[0]);
+
+      opts->spawn_rate = argv[++i];
+
+    } else if (strcmp(argv[i], "--init") == 0) {
+      opts->init = 1;
+
+    } else if (strcmp(argv[i], "--prefix-output") == 0) {
+      opts->prefix_output = 1;
+
+    } else if (strcmp(argv[i], "--startup-bench") == 0) {
+      opts->bench = 1000;  // Default number of launches
+
+      if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+        opts->bench = atoi(argv[++i]);
+
+    } else if (strcmp(argv[i], "--startup-probe") == 0) {  // Internal, see bench.c
+      if (i + 1 >= argc)
+        usage(argv[0]);
+
+      opts->probe = argv[++i];
+
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      usage(argv[0]);
+
+    } else if (!opts->script) {
+      opts->script = argv[i];
+
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  if (norc)
+    opts->rc = NULL;
+  else if (!opts->rc)
+    opts->rc = default_rc();
+
+  // Command indices only mean something when replaying the same script
+  if (opts->journal && !opts->script) {
+    fprintf(stderr, "%s: --journal and --resume need a script\n", argv[0]);
+    exit(2);
+  }
+}
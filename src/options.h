@@ -0,0 +1,35 @@
+// options.h
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#define SMALLSH_VERSION "1.0"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct shell_options
+// description: Command line options smallsh was started with
+//              Filled in once by parse_options() before the shell runs
+// --------------------------------------------------------------- //
+struct shell_options {
+  char* script;   // script file to run instead of stdin (NULL if none)
+  char* rc;       // startup file run first (NULL for --norc)
+  char* journal;  // journal file for --journal / --resume (NULL if none)
+  int   resume;   // skip commands already completed in journal
+  int   quiet;    // do not print the smallsh banner
+  int   beneath;  // redirections may only name files under the cwd
+  int   lookahead;  // script lines to prefetch ahead of execution
+  int   pipeline;   // read and parse the script on their own threads
+  int   cache;      // run scripts from their compiled snapshot
+  int   jobs;       // --jobs: jobserver slots to serve (0 if off)
+  char* pressure;   // --pressure: PSI limits for & jobs, "cpu=N,io=N" (NULL if off)
+  char* spawn_rate; // --spawn-rate: & jobs a second, "RATE[:BURST]" (NULL if off)
+  int   init;       // --init: subreaper, reap everything, forward signals
+  int   prefix_output;  // --prefix-output: & job lines as "[pid] line"
+  int   bench;    // --startup-bench: number of launches to time (0 if off)
+  char* probe;    // --startup-probe: "fd:ns" left by the benchmark parent
+};
+
+void parse_options(int argc, char* argv[], struct shell_options *opts);
+
+#endif
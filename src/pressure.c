@@ -0,0 +1,220 @@
+// pressure.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include "src/pressure.h"
+
+#define SAMPLE_NS 50000000L  // Readings are reused for 50 ms
+
+
+// --------------------------------------------------------------- //
+// structure  : struct resource
+// description: One PSI file and the limit set for it. avg10 is the
+//              "some" line's share of the last 10 s, in percent
+// --------------------------------------------------------------- //
+struct resource {
+  const char*   name;
+  int           fd;     // Kept open and read again from offset 0
+  double        limit;  // Percent, or -1 when not limited
+  double        avg10;  // Last reading
+  unsigned long deferred;
+};
+
+static struct resource resources[PRESSURE_KINDS] = {
+  { "cpu",    -1, -1, 0, 0 },
+  { "memory", -1, -1, 0, 0 },
+  { "io",     -1, -1, 0, 0 },
+};
+
+static int limited = 0;  // Some limit is set and its file open
+static long long sampled_ns = -1;  // When the readings were taken
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_init(..)
+// parameters : const char* spec
+// description: Sets the limits from --pressure, a comma separated list
+//              of name=percent, and opens their PSI files
+//              Returns -1 if spec doesn't parse
+// example    : pressure_init("cpu=80,memory=10")
+// --------------------------------------------------------------- //
+int pressure_init(const char* spec) {
+  char* copy = strdup(spec);
+  char* save = NULL;
+  int result = 0;
+
+  for (char* item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+    char* value = strchr(item, '=');
+    char* end = NULL;
+    int kind = -1;
+
+    if (value) {
+      *value++ = '\0';
+      for (int k = 0; k < PRESSURE_KINDS; k++) {
+        if (strcmp(item, resources[k].name) == 0)
+          kind = k;
+      }
+    }
+
+    double limit = value ? strtod(value, &end) : -1;
+
+    if (kind == -1 || end == value || *end || limit < 0 || limit > 100) {
+      fprintf(stderr, "smallsh: --pressure: expected cpu=N, memory=N or io=N, got %s\n", item);
+      result = -1;
+      break;
+    }
+
+    resources[kind].limit = limit;
+  }
+
+  free(copy);
+
+  for (int k = 0; k < PRESSURE_KINDS && result == 0; k++) {
+    char path[64];
+
+    if (resources[k].limit < 0 || resources[k].fd != -1)
+      continue;
+
+    snprintf(path, sizeof(path), "/proc/pressure/%s", resources[k].name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    // Kept clear of exec N's 0-9
+    if (fd == -1 || (resources[k].fd = fcntl(fd, F_DUPFD_CLOEXEC, 10)) == -1) {
+      fprintf(stderr, "smallsh: %s unavailable, %s pressure is not limited\n", path, resources[k].name);
+      resources[k].limit = -1;
+    } else {
+      limited = 1;
+    }
+
+    if (fd != -1)
+      close(fd);
+  }
+
+  return result;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sample()
+// parameters : none
+// description: Reads avg10 of every limited resource, unless the last
+//              readings are recent enough. The kernel only updates
+//              the averages every 2 s, so reading more often gains
+//              nothing
+// --------------------------------------------------------------- //
+static void sample() {
+  struct timespec now;
+  char buf[256];
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long now_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+
+  if (sampled_ns != -1 && now_ns - sampled_ns < SAMPLE_NS)
+    return;
+
+  sampled_ns = now_ns;
+
+  for (int k = 0; k < PRESSURE_KINDS; k++) {
+    if (resources[k].fd == -1)
+      continue;
+
+    ssize_t n = pread(resources[k].fd, buf, sizeof(buf) - 1, 0);
+
+    if (n <= 0)
+      continue;  // Keep the last reading
+
+    buf[n] = '\0';
+    sscanf(buf, "some avg10=%lf", &resources[k].avg10);
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_over()
+// parameters : none
+// description: Returns the first resource over its limit, or -1 if
+//              none is (or no limits are set)
+// --------------------------------------------------------------- //
+int pressure_over() {
+  if (!limited)
+    return -1;
+
+  sample();
+
+  for (int k = 0; k < PRESSURE_KINDS; k++) {
+    if (resources[k].limit >= 0 && resources[k].avg10 > resources[k].limit)
+      return k;
+  }
+
+  return -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_deferred(..)
+// parameters : int kind
+// description: Counts a job held back by pressure on kind (stats)
+// --------------------------------------------------------------- //
+void pressure_deferred(int kind) {
+  resources[kind].deferred++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_name(..)
+// parameters : int kind
+// description: Returns cpu, memory or io
+// --------------------------------------------------------------- //
+const char* pressure_name(int kind) {
+  return resources[kind].name;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_value(..)
+// parameters : int kind
+// description: Returns the last avg10 read for kind, in percent
+// --------------------------------------------------------------- //
+double pressure_value(int kind) {
+  return resources[kind].avg10;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_wait(..)
+// parameters : void (*reap)()
+// description: Sleeps PRESSURE_POLL_MS for pressure to come down, then
+//              lets reap() collect jobs that exited meanwhile
+// --------------------------------------------------------------- //
+void pressure_wait(void (*reap)()) {
+  poll(NULL, 0, PRESSURE_POLL_MS);
+  reap();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : pressure_print_stats()
+// parameters : none
+// description: Prints each limit, the last reading and the jobs held
+//              back by it (stats), nothing if no limit is set
+// --------------------------------------------------------------- //
+void pressure_print_stats() {
+  if (!limited)
+    return;
+
+  sample();
+
+  for (int k = 0; k < PRESSURE_KINDS; k++) {
+    if (resources[k].limit < 0)
+      continue;
+
+    printf("pressure: %s %.2f%% (limit %.2f%%), %lu deferred\n", resources[k].name,
+           resources[k].avg10, resources[k].limit, resources[k].deferred);
+  }
+  fflush(stdout);
+}
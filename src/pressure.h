@@ -0,0 +1,30 @@
+// pressure.h
+
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+
+// --------------------------------------------------------------- //
+// description: Pressure stall limits for & jobs (--pressure). The
+//              kernel's PSI files in /proc/pressure give the share of
+//              the last 10 s some task stalled on cpu, memory or io;
+//              while one is over its limit, new & jobs are queued
+//              (see sched.c) and start once it has come down again
+// --------------------------------------------------------------- //
+#define PRESSURE_CPU     0
+#define PRESSURE_MEMORY  1
+#define PRESSURE_IO      2
+#define PRESSURE_KINDS   3
+
+#define PRESSURE_POLL_MS   250    // How often held back jobs look again
+#define PRESSURE_FINISH_MS 10000  // At exit, how long queued jobs wait it out
+
+int         pressure_init(const char* spec);
+int         pressure_over();
+void        pressure_deferred(int kind);
+const char* pressure_name(int kind);
+double      pressure_value(int kind);
+void        pressure_wait(void (*reap)());
+void        pressure_print_stats();
+
+#endif
@@ -0,0 +1,165 @@
+// ratelimit.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <time.h>
+#include "src/ratelimit.h"
+
+static double rate = 0;    // Tokens a second, 0 when not limited
+static double burst = 0;   // Bucket size
+static double tokens = 0;
+static long long filled_ns = 0;  // When tokens was last brought up to date
+
+static unsigned long stat_started = 0;
+static unsigned long stat_deferred = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : now_ns()
+// parameters : none
+// description: Returns CLOCK_MONOTONIC in nanoseconds
+// --------------------------------------------------------------- //
+static long long now_ns() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_init(..)
+// parameters : const char* spec
+// description: Sets the limit from --spawn-rate, RATE or RATE:BURST
+//              in jobs a second. The burst defaults to one second's
+//              worth (at least 1), and the bucket starts full
+//              Returns -1 if spec doesn't parse
+// example    : ratelimit_init("50:200")
+// --------------------------------------------------------------- //
+int ratelimit_init(const char* spec) {
+  char* end;
+
+  rate = strtod(spec, &end);
+  burst = rate < 1 ? 1 : rate;
+
+  int ok = end != spec && rate > 0;
+
+  if (ok && *end == ':') {
+    char* b = end + 1;
+    burst = strtod(b, &end);
+    ok = end != b && burst >= 1;
+  }
+
+  if (!ok || *end) {
+    fprintf(stderr, "smallsh: --spawn-rate: expected RATE or RATE:BURST, got %s\n", spec);
+    rate = 0;
+    return -1;
+  }
+
+  tokens = burst;
+  filled_ns = now_ns();
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : refill()
+// parameters : none
+// description: Adds the tokens earned since the last refill
+// --------------------------------------------------------------- //
+static void refill() {
+  long long now = now_ns();
+
+  tokens += (now - filled_ns) * rate / 1e9;
+  if (tokens > burst)
+    tokens = burst;
+  filled_ns = now;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_ready()
+// parameters : none
+// description: Returns 1 if a job may be started now (always, with no
+//              limit set)
+// --------------------------------------------------------------- //
+int ratelimit_ready() {
+  if (rate == 0)
+    return 1;
+
+  refill();
+  return tokens >= 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_take()
+// parameters : none
+// description: Spends a token on a job being started
+// --------------------------------------------------------------- //
+void ratelimit_take() {
+  if (rate == 0)
+    return;
+
+  refill();
+  tokens--;
+  stat_started++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_deferred()
+// parameters : none
+// description: Counts a job queued for the bucket to fill (stats)
+// --------------------------------------------------------------- //
+void ratelimit_deferred() {
+  stat_deferred++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_next_ms()
+// parameters : none
+// description: Returns the milliseconds until the bucket has a token,
+//              0 if it has one now (or there is no limit)
+// --------------------------------------------------------------- //
+int ratelimit_next_ms() {
+  if (rate == 0 || ratelimit_ready())
+    return 0;
+
+  return (int)((1 - tokens) * 1000 / rate) + 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_wait(..)
+// parameters : void (*reap)()
+// description: Sleeps until the bucket has a token, then lets reap()
+//              collect jobs that exited meanwhile
+// --------------------------------------------------------------- //
+void ratelimit_wait(void (*reap)()) {
+  int ms = ratelimit_next_ms();
+
+  if (ms)
+    poll(NULL, 0, ms);
+
+  reap();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ratelimit_print_stats()
+// parameters : none
+// description: Prints the limit and its counters (stats), nothing if
+//              no limit is set
+// --------------------------------------------------------------- //
+void ratelimit_print_stats() {
+  if (rate == 0)
+    return;
+
+  refill();
+  printf("spawn rate: %g/s, burst %g, %.1f tokens, %lu started, %lu deferred\n",
+         rate, burst, tokens, stat_started, stat_deferred);
+  fflush(stdout);
+}
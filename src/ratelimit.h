@@ -0,0 +1,23 @@
+// ratelimit.h
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+
+// --------------------------------------------------------------- //
+// description: Spawn rate limit for & jobs (--spawn-rate). A token
+//              bucket fills at rate tokens a second up to burst; each
+//              job started takes one, and with the bucket empty new
+//              jobs are queued (see sched.c) until it fills again, so
+//              a script starting thousands of jobs doesn't fork them
+//              all at once
+// --------------------------------------------------------------- //
+int  ratelimit_init(const char* spec);
+int  ratelimit_ready();
+void ratelimit_take();
+void ratelimit_deferred();
+int  ratelimit_next_ms();
+void ratelimit_wait(void (*reap)());
+void ratelimit_print_stats();
+
+#endif
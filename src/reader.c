@@ -0,0 +1,449 @@
+// reader.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <sys/stat.h>
+#include "src/reader.h"
+#include "src/snapshot.h"
+
+#define RING_SIZE  256  // Slots per ring, a power of two
+#define SPIN       128  // Polls before a stage goes to sleep
+
+// --------------------------------------------------------------- //
+// structure  : struct ring
+// description: Lock-free queue with exactly one producer and one
+//              consumer thread. Each side only writes its own index,
+//              so pushing and popping are a load and a store. A side
+//              that finds the ring full or empty spins briefly, then
+//              sleeps on the other side's index with a futex. The
+//              waiting flags let the other side skip the wake syscall
+//              when nobody sleeps, and a full producer is only woken
+//              once half the ring is free, not for every slot. A NULL
+//              entry marks end of input
+// --------------------------------------------------------------- //
+struct ring {
+  _Atomic uint32_t head;     // Next slot to pop, written by the consumer
+  _Atomic uint32_t tail;     // Next slot to fill, written by the producer
+  _Atomic int pop_waiting;   // Consumer is asleep on tail
+  _Atomic int push_waiting;  // Producer is asleep on head
+  _Atomic unsigned long stalls;  // Times the producer found the ring full
+  void* slots[RING_SIZE];
+};
+
+static FILE* input = NULL;
+static int   threaded = 0;
+static int   compiled = 0;    // Lines come from script, not input
+static struct snapshot script;
+static int   at_eof = 0;      // End of input handed out
+static _Atomic int stopping;  // reader_stop() called, stages quit
+
+static struct ring lines;     // Reader thread -> parser thread
+static struct ring cmds;      // Parser thread -> main thread
+static pthread_t reader_thread;
+static pthread_t parser_thread;
+
+// Counters for 'stats'
+static unsigned long stat_lines = 0;  // Lines handed out
+static unsigned long stat_waits = 0;  // Times the main thread had nothing ready
+
+
+// --------------------------------------------------------------- //
+// function   : futex(..)
+// parameters : _Atomic uint32_t *addr
+//              int op
+//              uint32_t val
+// description: FUTEX_WAIT sleeps while *addr is val, FUTEX_WAKE
+//              wakes up to val sleepers
+// --------------------------------------------------------------- //
+static void futex(_Atomic uint32_t *addr, int op, uint32_t val) {
+  syscall(SYS_futex, addr, op | FUTEX_PRIVATE_FLAG, val, NULL, NULL, 0);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ring_push(..)
+// parameters : struct ring *r
+//              void* item
+// description: Adds item, sleeping while the ring is full
+//              Returns 0 if the reader is being stopped instead
+// --------------------------------------------------------------- //
+static int ring_push(struct ring *r, void* item) {
+  uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  int spins = 0;
+  int stalled = 0;
+
+  for (;;) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+
+    if (atomic_load(&stopping))
+      return 0;
+    if (tail - head < RING_SIZE)
+      break;
+
+    if (!stalled++)
+      r->stalls++;
+
+    if (++spins < SPIN)
+      continue;
+
+    atomic_store(&r->push_waiting, 1);
+    if (atomic_load(&r->head) == head && !atomic_load(&stopping))
+      futex(&r->head, FUTEX_WAIT, head);  // Sleep until a slot frees
+    atomic_store(&r->push_waiting, 0);
+  }
+
+  r->slots[tail % RING_SIZE] = item;
+  atomic_store(&r->tail, tail + 1);  // Publishes the slot
+
+  if (atomic_load(&r->pop_waiting))
+    futex(&r->tail, FUTEX_WAKE, 1);
+
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : ring_pop(..)
+// parameters : struct ring *r
+//              void** item
+//              int wait
+// description: Takes the oldest item. Without wait, returns 0 at once
+//              if the ring is empty, otherwise sleeps until an item
+//              arrives. Returns 0 if the reader is being stopped
+// --------------------------------------------------------------- //
+static int ring_pop(struct ring *r, void** item, int wait) {
+  uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  int spins = 0;
+
+  for (;;) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+
+    if (tail != head)
+      break;
+    if (!wait || atomic_load(&stopping))
+      return 0;
+
+    if (++spins < SPIN)
+      continue;
+
+    atomic_store(&r->pop_waiting, 1);
+    if (atomic_load(&r->tail) == tail && !atomic_load(&stopping))
+      futex(&r->tail, FUTEX_WAIT, tail);  // Sleep until an item lands
+    atomic_store(&r->pop_waiting, 0);
+  }
+
+  *item = r->slots[head % RING_SIZE];
+  atomic_store(&r->head, head + 1);  // Hands the slot back
+
+  if (atomic_load(&r->push_waiting) &&
+      atomic_load(&r->tail) - (head + 1) <= RING_SIZE / 2)
+    futex(&r->head, FUTEX_WAKE, 1);
+
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : cmd_desc_parse(..)
+// parameters : const char* line
+// description: Splits a copy of line into words delimited by " "
+//              Returns the descriptor, the caller frees it
+// --------------------------------------------------------------- //
+struct cmd_desc* cmd_desc_parse(const char* line) {
+  size_t size = strlen(line) + 1;
+  int words = 0;
+
+  for (const char* p = line; *p; p++)  // Upper bound, one per word start
+    if (*p != ' ' && (p == line || p[-1] == ' '))
+      words++;
+
+  struct cmd_desc* d = malloc(sizeof(*d) + (words + 1) * sizeof(char*) + size);
+  char* copy = (char*)&d->tokens[words + 1];
+  char* saveptr;
+  char* token;
+
+  memcpy(copy, line, size);
+  d->len = 0;
+
+  token = strtok_r(copy, " ", &saveptr);
+  while (token) {
+    d->tokens[d->len++] = token;
+    token = strtok_r(NULL, " ", &saveptr);
+  }
+  d->tokens[d->len] = NULL;
+
+  return d;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : read_line()
+// parameters : none
+// description: Reads the next line of the script, newline removed
+//              Returns NULL at end of input
+// --------------------------------------------------------------- //
+static char* read_line() {
+  char* line = NULL;
+  size_t size = 0;
+
+  if (getline(&line, &size, input) == -1) {
+    free(line);
+    return NULL;
+  }
+
+  strtok(line, "\n");  // Remove newline, same as get_input()
+  return line;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : read_stage(..)
+// parameters : void* unused
+// description: Reader thread. Reads lines into the lines ring
+// --------------------------------------------------------------- //
+static void* read_stage(void* unused) {
+  char* line;
+
+  do {
+    line = read_line();
+
+    if (!ring_push(&lines, line)) {
+      free(line);
+      break;
+    }
+  } while (line);
+
+  return NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : parse_stage(..)
+// parameters : void* unused
+// description: Parser thread. Splits lines from the lines ring and
+//              passes the descriptors on to the main thread
+// --------------------------------------------------------------- //
+static void* parse_stage(void* unused) {
+  void* line;
+  struct cmd_desc* d;
+
+  do {
+    if (!ring_pop(&lines, &line, 1))
+      break;
+
+    d = line ? cmd_desc_parse(line) : NULL;
+    free(line);
+
+    if (!ring_push(&cmds, d)) {
+      free(d);
+      break;
+    }
+  } while (d);
+
+  return NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reader_init(..)
+// parameters : FILE* in
+//              int threads
+// description: Reads the script from in. With threads, starts the
+//              reader and parser threads. They block all signals, so
+//              SIGINT, SIGTSTP and SIGCHLD still reach the main thread
+//              Falls back to reading inline if a thread can't start
+// --------------------------------------------------------------- //
+void reader_init(FILE* in, int threads) {
+  sigset_t all, old;
+
+  input = in;
+
+  if (!threads)
+    return;
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);  // Inherited by the threads
+
+  // The parser starts first: until the reader runs, nothing is read
+  if (pthread_create(&parser_thread, NULL, parse_stage, NULL) == 0) {
+    if (pthread_create(&reader_thread, NULL, read_stage, NULL) == 0) {
+      threaded = 1;
+    } else {
+      atomic_store(&stopping, 1);
+      futex(&lines.tail, FUTEX_WAKE, 1);
+      pthread_join(parser_thread, NULL);
+      atomic_store(&stopping, 0);
+    }
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reader_init_compiled(..)
+// parameters : const char* path
+// description: Reads the script at path through its compiled snapshot
+//              (see snapshot.c), mapping the cached one when the
+//              script hasn't changed. Only regular files are compiled:
+//              a pipe would have to be read to the end first
+//              Returns -1 if the script should be read as text instead
+// --------------------------------------------------------------- //
+int reader_init_compiled(const char* path) {
+  struct stat st;
+
+  if (stat(path, &st) == -1 || !S_ISREG(st.st_mode) || snapshot_open(&script, path) == -1)
+    return -1;
+
+  compiled = 1;
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reader_next(..)
+// parameters : int wait
+// description: Returns the next script line as a descriptor (caller
+//              frees it), or NULL at end of input. When threaded and
+//              wait is 0, also returns NULL if no line is parsed yet
+// --------------------------------------------------------------- //
+struct cmd_desc* reader_next(int wait) {
+  struct cmd_desc* d = NULL;
+
+  if (at_eof || (!input && !compiled))
+    return NULL;
+
+  if (compiled) {
+    d = snapshot_next(&script);
+
+  } else if (!threaded) {
+    char* line = read_line();
+
+    if (line) {
+      d = cmd_desc_parse(line);
+      free(line);
+    }
+
+  } else {
+    void* item;
+
+    if (!ring_pop(&cmds, &item, 0)) {
+      if (!wait)
+        return NULL;
+
+      stat_waits++;  // Parsing fell behind
+      ring_pop(&cmds, &item, 1);
+    }
+    d = item;
+  }
+
+  if (!d)
+    at_eof = 1;
+  else
+    stat_lines++;
+
+  return d;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : drain(..)
+// parameters : struct ring *r
+// description: Frees the items left in a ring after its stages quit
+// --------------------------------------------------------------- //
+static void drain(struct ring *r) {
+  while (r->head != r->tail) {
+    free(r->slots[r->head % RING_SIZE]);
+    r->head++;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reader_stop()
+// parameters : none
+// description: Stops the reader and parser threads and frees what
+//              they read ahead. Must be called before the script file
+//              is closed. The reader may be blocked reading a pipe, so
+//              it is cancelled rather than waited for
+// --------------------------------------------------------------- //
+void reader_stop() {
+  if (compiled) {
+    snapshot_close(&script);
+    compiled = 0;
+  }
+
+  if (!threaded)
+    return;
+
+  atomic_store(&stopping, 1);
+  futex(&lines.head, FUTEX_WAKE, 1);
+  futex(&lines.tail, FUTEX_WAKE, 1);
+  futex(&cmds.head, FUTEX_WAKE, 1);
+
+  pthread_cancel(reader_thread);
+  pthread_join(reader_thread, NULL);
+  pthread_join(parser_thread, NULL);
+
+  drain(&lines);
+  drain(&cmds);
+  threaded = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reader_detach()
+// parameters : none
+// description: Forgets the script in a forked copy of the shell. The
+//              threads weren't copied by fork, so there is nothing to
+//              join. The copy's descriptor for the script is closed:
+//              the file offset is shared with the parent, and stdio
+//              must never move it from here
+// --------------------------------------------------------------- //
+void reader_detach() {
+  if (input)
+    close(fileno_unlocked(input));  // Its lock may belong to a thread fork didn't copy
+
+  if (compiled)
+    snapshot_close(&script);
+
+  input = NULL;
+  threaded = compiled = at_eof = 0;
+  atomic_store(&lines.head, 0);
+  atomic_store(&lines.tail, 0);
+  atomic_store(&cmds.head, 0);
+  atomic_store(&cmds.tail, 0);
+  stat_lines = stat_waits = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reader_print_stats()
+// parameters : none
+// description: Prints the reader counters (stats)
+// --------------------------------------------------------------- //
+void reader_print_stats() {
+  if (compiled) {
+    printf("reader: compiled, %s, %lu lines\n",
+           script.cached ? "from cache" : "compiled this run", stat_lines);
+    fflush(stdout);
+  }
+
+  if (!input)
+    return;
+
+  printf("reader: %s, %lu lines, %lu waits for the parser, "
+         "%lu reader stalls, %lu parser stalls\n",
+         threaded ? "threaded" : "inline", stat_lines, stat_waits,
+         lines.stalls, cmds.stalls);
+  fflush(stdout);
+}
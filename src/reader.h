@@ -0,0 +1,37 @@
+// reader.h
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdio.h>
+
+
+// --------------------------------------------------------------- //
+// structure  : struct cmd_desc
+// description: One input line split into words. The words are kept
+//              right after the token array, so the whole descriptor
+//              is a single allocation released with free()
+// --------------------------------------------------------------- //
+struct cmd_desc {
+  int   len;       // Number of words
+  char* tokens[];  // The words, NULL terminated
+};
+
+struct cmd_desc* cmd_desc_parse(const char* line);
+
+// --------------------------------------------------------------- //
+// description: Script reader. Hands out the script's lines already
+//              split into words. When threaded, a reader thread reads
+//              lines and a parser thread splits them, each feeding the
+//              next stage through a lock-free single-producer ring, so
+//              the main thread only has to run commands. A compiled
+//              script is handed out straight from its cached snapshot
+// --------------------------------------------------------------- //
+void reader_init(FILE* in, int threaded);
+int  reader_init_compiled(const char* path);
+struct cmd_desc* reader_next(int wait);
+void reader_stop();
+void reader_detach();
+void reader_print_stats();
+
+#endif
@@ -0,0 +1,294 @@
+// reaper.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "src/reaper.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct child
+// description: A child the shell started, and its status once the
+//              SIGCHLD handler has reaped it
+// --------------------------------------------------------------- //
+struct child {
+  pid_t pid;
+  int   exited;
+  int   status;
+};
+
+// Only changed with the handled signals blocked, read by the handlers
+static struct child* children = NULL;
+static int children_len = 0;
+static int children_cap = 0;
+
+static int active = 0;
+static sigset_t handled;  // SIGCHLD and the forwarded signals
+static volatile pid_t foreground = 0;
+static volatile sig_atomic_t terminated = 0;
+
+static const int forwarded[] = { SIGTERM, SIGHUP, SIGQUIT, SIGINT, SIGUSR1, SIGUSR2 };
+#define FORWARDED (int)(sizeof(forwarded) / sizeof(forwarded[0]))
+
+static volatile unsigned long stat_children = 0;
+static volatile unsigned long stat_orphans = 0;
+static volatile unsigned long stat_forwarded = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : find(..)
+// parameters : pid_t pid
+// description: Returns the shell's own child pid, or NULL
+// --------------------------------------------------------------- //
+static struct child* find(pid_t pid) {
+  for (int i = 0; i < children_len; i++) {
+    if (children[i].pid == pid)
+      return &children[i];
+  }
+
+  return NULL;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : on_child(..)
+// parameters : int signo
+// description: SIGCHLD handler. Reaps every child that exited: keeps
+//              the status of our own, counts the orphans
+// --------------------------------------------------------------- //
+static void on_child(int signo) {
+  int saved = errno;
+  int status;
+  pid_t pid;
+
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    struct child* c = find(pid);
+
+    if (c) {
+      c->status = status;
+      c->exited = 1;
+    } else {
+      stat_orphans++;
+    }
+  }
+
+  errno = saved;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : on_signal(..)
+// parameters : int signo
+// description: Handler for the forwarded signals. Passes the signal
+//              on to the foreground job. With none, SIGTERM and SIGHUP
+//              go to every running job and end the shell; others are
+//              ignored, as ^C at the prompt is without --init
+// --------------------------------------------------------------- //
+static void on_signal(int signo) {
+  int ends = (signo == SIGTERM || signo == SIGHUP);
+  pid_t fg = foreground;
+
+  if (fg > 0) {
+    kill(fg, signo);
+    stat_forwarded++;
+
+    if (ends)
+      terminated = signo;  // Stop once the job has gone
+    return;
+  }
+
+  if (!ends)
+    return;
+
+  for (int i = 0; i < children_len; i++) {
+    if (!children[i].exited)
+      kill(children[i].pid, signo);
+  }
+
+  _exit(128 + signo);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reaper_init()
+// parameters : none
+// description: Turns on init mode: child subreaper, continuous
+//              reaping and signal forwarding
+// --------------------------------------------------------------- //
+void reaper_init() {
+  struct sigaction action = { 0 };
+
+  if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1)
+    perror("smallsh: PR_SET_CHILD_SUBREAPER");  // Still reaps its own children
+
+  sigemptyset(&handled);
+  sigaddset(&handled, SIGCHLD);
+  for (int i = 0; i < FORWARDED; i++)
+    sigaddset(&handled, forwarded[i]);
+
+  action.sa_mask = handled;  // Handlers don't interrupt each other
+  action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  action.sa_handler = on_child;
+  sigaction(SIGCHLD, &action, NULL);
+
+  action.sa_flags = SA_RESTART;
+  action.sa_handler = on_signal;
+  for (int i = 0; i < FORWARDED; i++)
+    sigaction(forwarded[i], &action, NULL);
+
+  active = 1;
+
+  raise(SIGCHLD);  // Zombies inherited from before
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reaper_fork()
+// parameters : none
+// description: fork(), recording the child as the shell's own before
+//              the handler can see it exit. The child is set back to
+//              the shell's usual signal handling, outside init mode
+// --------------------------------------------------------------- //
+pid_t reaper_fork() {
+  sigset_t old;
+
+  if (!active)
+    return fork();
+
+  sigprocmask(SIG_BLOCK, &handled, &old);
+
+  if (children_len == children_cap) {
+    children_cap = children_cap ? children_cap * 2 : 64;
+    children = realloc(children, children_cap * sizeof(struct child));
+
+    if (!children) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    struct sigaction action = { 0 };
+
+    active = 0;
+    foreground = 0;
+    free(children);
+    children = NULL;
+    children_len = children_cap = 0;
+
+    action.sa_handler = SIG_DFL;
+    sigaction(SIGCHLD, &action, NULL);
+    for (int i = 0; i < FORWARDED; i++) {
+      action.sa_handler = forwarded[i] == SIGINT ? SIG_IGN : SIG_DFL;  // See custom_SIG
+      sigaction(forwarded[i], &action, NULL);
+    }
+
+  } else if (pid > 0) {
+    children[children_len].pid = pid;
+    children[children_len].exited = 0;
+    children_len++;
+    stat_children++;
+  }
+
+  sigprocmask(SIG_SETMASK, &old, NULL);
+  return pid;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reaper_wait(..)
+// parameters : pid_t pid
+//              int *status
+//              int options
+// description: waitpid() for the shell's own children, pid or any
+//              (-1), taking statuses the handler kept. Options may be
+//              WNOHANG. Fails with ECHILD when no child is left
+// --------------------------------------------------------------- //
+pid_t reaper_wait(pid_t pid, int *status, int options) {
+  sigset_t old;
+  int running;
+
+  if (!active)
+    return waitpid(pid, status, options);
+
+  sigprocmask(SIG_BLOCK, &handled, &old);
+
+  for (;;) {
+    running = 0;
+
+    for (int i = 0; i < children_len; i++) {
+      if (pid != -1 && children[i].pid != pid)
+        continue;
+
+      if (!children[i].exited) {
+        running = 1;
+        continue;
+      }
+
+      pid_t done = children[i].pid;
+
+      if (status)
+        *status = children[i].status;
+      children[i] = children[--children_len];
+
+      sigprocmask(SIG_SETMASK, &old, NULL);
+      return done;
+    }
+
+    if (!running || (options & WNOHANG))
+      break;
+
+    sigsuspend(&old);  // Until the handler has reaped something
+  }
+
+  sigprocmask(SIG_SETMASK, &old, NULL);
+
+  if (running)
+    return 0;
+
+  errno = ECHILD;
+  return -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reaper_foreground(..)
+// parameters : pid_t pid
+// description: Sets the job forwarded signals go to, 0 for none
+// --------------------------------------------------------------- //
+void reaper_foreground(pid_t pid) {
+  foreground = pid;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reaper_terminated()
+// parameters : none
+// description: Returns the SIGTERM or SIGHUP passed on to the
+//              foreground job, after which the shell should end, or 0
+// --------------------------------------------------------------- //
+int reaper_terminated() {
+  return terminated;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : reaper_print_stats()
+// parameters : none
+// description: Prints the init mode counters (stats), nothing outside
+//              init mode
+// --------------------------------------------------------------- //
+void reaper_print_stats() {
+  if (!active)
+    return;
+
+  printf("init: %lu children, %lu orphans reaped, %lu signals forwarded\n",
+         stat_children, stat_orphans, stat_forwarded);
+  fflush(stdout);
+}
@@ -0,0 +1,30 @@
+// reaper.h
+
+#ifndef REAPER_H
+#define REAPER_H
+
+#include <sys/types.h>
+
+
+// --------------------------------------------------------------- //
+// description: Init mode (--init, or when smallsh is pid 1, as the
+//              entrypoint of a container). The shell becomes a child
+//              subreaper, so orphaned descendants are reparented to
+//              it, and a SIGCHLD handler reaps every child as soon as
+//              it exits, even while the shell waits for input. The
+//              statuses of the shell's own children are kept for
+//              reaper_wait(); orphans are only counted. Termination
+//              signals go to the foreground job, or end the shell
+//              (and its jobs) when there is none
+//              Children are started with reaper_fork() and waited for
+//              with reaper_wait(), which are fork() and waitpid()
+//              outside init mode
+// --------------------------------------------------------------- //
+void  reaper_init();
+pid_t reaper_fork();
+pid_t reaper_wait(pid_t pid, int *status, int options);
+void  reaper_foreground(pid_t pid);
+int   reaper_terminated();
+void  reaper_print_stats();
+
+#endif
@@ -0,0 +1,659 @@
+// sched.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "src/sched.h"
+#include "src/dirs.h"
+#include "src/jobserver.h"
+#include "src/pressure.h"
+#include "src/ratelimit.h"
+
+// ioprio_set() has no glibc wrapper
+#define IOPRIO_WHO_PROCESS  1
+#define IOPRIO_CLASS_BE     2
+#define IOPRIO_CLASS_IDLE   3
+#define IOPRIO_VALUE(class, level) (((class) << 13) | (level))
+
+
+// --------------------------------------------------------------- //
+// structure  : struct place
+// description: A working directory jobs were queued in, held open
+//              Jobs queued one after another from the same directory
+//              share it, so a long queue doesn't hold an fd per job
+// --------------------------------------------------------------- //
+struct place {
+  char* path;
+  int   fd;
+  dev_t dev;
+  ino_t ino;
+  int   refs;
+};
+
+
+// --------------------------------------------------------------- //
+// structure  : struct pending
+// description: A & job waiting for a token: a command's words, or a
+//              ( ... ) or { ...; } group. They and its shell_info are
+//              copied off the command arena, which is reset before the
+//              job gets to run. The working directory and
+//              environment it was queued in are kept too: it may only
+//              start during some later command, after a cd or export
+// --------------------------------------------------------------- //
+struct pending {
+  char**            args;   // NULL for a group
+  struct command*   group;  // NULL for a command
+  struct shell_info info;
+  struct place*     cwd;  // NULL if it couldn't be held, runs wherever the shell is
+  char**            env;
+  unsigned long     seq;  // Order queued, first come first served
+  long long         queued_ns;  // When, for the time spent queued
+};
+
+static sched_launch_fn launch_fn = NULL;
+
+static struct pending* queue = NULL;
+static int queue_len = 0;
+static int queue_cap = 0;
+static unsigned long queue_seq = 0;
+
+static struct place* last_place = NULL;  // Latest jobs were queued in
+
+static pid_t* stopped = NULL;  // Low jobs (and process groups) stopped for a high one, oldest first
+static int stopped_len = 0;
+static int stopped_cap = 0;
+
+static unsigned long stat_queued = 0;
+static unsigned long stat_preempted = 0;
+static unsigned long stat_resumed = 0;
+static long long stat_queued_ns = 0;  // Time started jobs spent queued
+static long long stat_queued_max_ns = 0;
+
+
+// --------------------------------------------------------------- //
+// function   : sched_level(..)
+// parameters : const char* name
+// description: Returns the priority named high, normal or low, or -1
+// --------------------------------------------------------------- //
+int sched_level(const char* name) {
+  if (strcmp(name, "high") == 0)
+    return PRIO_HIGH;
+  if (strcmp(name, "normal") == 0)
+    return PRIO_NORMAL;
+  if (strcmp(name, "low") == 0)
+    return PRIO_LOW;
+
+  return -1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_apply(..)
+// parameters : int prio
+// description: Called in the child before exec. Low priority gets
+//              nice 19, SCHED_IDLE and the idle I/O class, so it only
+//              uses CPU and disk nothing else wants. High gets the top
+//              best-effort I/O level (raising nice needs privileges)
+//              Failures are ignored, the command still runs
+// --------------------------------------------------------------- //
+void sched_apply(int prio) {
+  if (prio == PRIO_LOW) {
+    struct sched_param param = { 0 };
+
+    setpriority(PRIO_PROCESS, 0, 19);
+    sched_setscheduler(0, SCHED_IDLE, &param);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+
+  } else if (prio == PRIO_HIGH) {
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_VALUE(IOPRIO_CLASS_BE, 0));
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_init(..)
+// parameters : sched_launch_fn launch
+// description: Sets how queued jobs are started
+// --------------------------------------------------------------- //
+void sched_init(sched_launch_fn launch) {
+  launch_fn = launch;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : now_ns()
+// parameters : none
+// description: Returns CLOCK_MONOTONIC in nanoseconds
+// --------------------------------------------------------------- //
+static long long now_ns() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : can_start()
+// parameters : none
+// description: Returns 1 unless pressure or the spawn rate holds new
+//              jobs back for now
+// --------------------------------------------------------------- //
+static int can_start() {
+  return pressure_over() == -1 && ratelimit_ready();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : best_queued()
+// parameters : none
+// description: Returns the index of the queued job to start next:
+//              highest priority, then first queued. -1 if none
+// --------------------------------------------------------------- //
+static int best_queued() {
+  int best = -1;
+
+  for (int i = 0; i < queue_len; i++) {
+    if (best == -1 || queue[i].info.priority < queue[best].info.priority ||
+        (queue[i].info.priority == queue[best].info.priority && queue[i].seq < queue[best].seq))
+      best = i;
+  }
+
+  return best;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : copy_words(..)
+// parameters : char** words
+// description: Returns a copy of a NULL terminated array of strings
+// --------------------------------------------------------------- //
+static char** copy_words(char** words) {
+  int n = 0;
+
+  while (words && words[n])
+    n++;
+
+  char** copy = malloc((n + 1) * sizeof(char*));
+
+  if (!copy) {
+    perror("malloc");
+    exit(1);
+  }
+
+  for (int a = 0; a < n; a++)
+    copy[a] = strdup(words[a]);
+  copy[n] = NULL;
+
+  return copy;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : free_words(..)
+// parameters : char** words
+// description: Frees a copy_words() copy
+// --------------------------------------------------------------- //
+static void free_words(char** words) {
+  for (int a = 0; words[a]; a++)
+    free(words[a]);
+  free(words);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : hold_cwd()
+// parameters : none
+// description: Returns the working directory held for a job being
+//              queued, shared with the job queued before it when the
+//              shell is still in the same directory. NULL on failure
+// --------------------------------------------------------------- //
+static struct place* hold_cwd() {
+  struct stat st;
+
+  if (stat(".", &st) == -1)
+    return NULL;
+
+  if (last_place && last_place->dev == st.st_dev && last_place->ino == st.st_ino) {
+    last_place->refs++;
+    return last_place;
+  }
+
+  struct place* p = malloc(sizeof(struct place));
+
+  if (!p || (p->fd = dir_save(&p->path)) == -1) {
+    free(p);
+    return NULL;
+  }
+
+  p->dev = st.st_dev;
+  p->ino = st.st_ino;
+  p->refs = 1;
+  last_place = p;
+  return p;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : release_cwd(..)
+// parameters : struct place* p
+// description: Lets go of a hold_cwd() directory
+// --------------------------------------------------------------- //
+static void release_cwd(struct place* p) {
+  if (!p || --p->refs)
+    return;
+
+  if (last_place == p)
+    last_place = NULL;
+
+  close(p->fd);
+  free(p->path);
+  free(p);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : forget_job(..)
+// parameters : struct pending *job
+// description: Frees a queued job's copies once it has started, or
+//              been dropped
+// --------------------------------------------------------------- //
+static void forget_job(struct pending *job) {
+  if (job->args)
+    free_words(job->args);
+  if (job->group)
+    free_command(job->group);
+  free_words(job->env);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : start_queued(..)
+// parameters : int i
+//              int token
+// description: Starts queued job i with token and forgets it
+// --------------------------------------------------------------- //
+static void start_queued(int i, int token) {
+  extern char** environ;
+  struct pending job = queue[i];
+  long long waited = now_ns() - job.queued_ns;
+  char* here_path = NULL;
+  int here_fd = job.cwd ? dir_save(&here_path) : -1;
+
+  queue[i] = queue[--queue_len];
+
+  stat_queued_ns += waited;
+  if (waited > stat_queued_max_ns)
+    stat_queued_max_ns = waited;
+
+  ratelimit_take();
+
+  // Started from where it was queued: lookup, redirections and the
+  // child's cwd and environment are as they were then
+  if (here_fd != -1)
+    dir_restore(strdup(job.cwd->path), fcntl(job.cwd->fd, F_DUPFD_CLOEXEC, 3));
+  release_cwd(job.cwd);
+
+  char** shell_env = environ;
+  environ = job.env;
+
+  launch_fn(job.args, job.group, &job.info, token);
+
+  environ = shell_env;
+  if (here_fd != -1)
+    dir_restore(here_path, here_fd);
+
+  forget_job(&job);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : resume_stopped(..)
+// parameters : int token
+// description: Continues the job stopped longest ago, holding token
+// --------------------------------------------------------------- //
+static void resume_stopped(int token) {
+  pid_t pid = stopped[0];
+
+  memmove(stopped, stopped + 1, --stopped_len * sizeof(pid_t));
+
+  jobserver_started(pid, token, PRIO_LOW);
+  kill(-pid, SIGCONT);
+  stat_resumed++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : enqueue(..)
+// parameters : char* args[]
+//              struct command* group
+//              struct shell_info *info
+// description: Queues a copy of a & job until a token is free, with
+//              the shell's current directory and environment
+// --------------------------------------------------------------- //
+static void enqueue(char* args[], struct command* group, struct shell_info *info) {
+  extern char** environ;
+
+  if (queue_len == queue_cap) {
+    queue_cap = queue_cap ? queue_cap * 2 : 16;
+    queue = realloc(queue, queue_cap * sizeof(struct pending));
+  }
+
+  if (!queue) {
+    perror("malloc");
+    exit(1);
+  }
+
+  queue[queue_len].args = group ? NULL : copy_words(args);
+  queue[queue_len].group = group ? copy_command(group) : NULL;
+  queue[queue_len].info = *info;
+  queue[queue_len].cwd = hold_cwd();
+  queue[queue_len].env = copy_words(environ);
+  queue[queue_len].seq = ++queue_seq;
+  queue[queue_len].queued_ns = now_ns();
+  queue_len++;
+  stat_queued++;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_admit(..)
+// parameters : char* args[]
+//              struct command* group
+//              struct shell_info *info
+// description: Decides when a & job, command args or a group (args
+//              NULL), may start. Returns the token to
+//              start it with now (JOBSERVER_NONE when jobs aren't
+//              limited), or SCHED_QUEUED after queuing it. A token
+//              that turns up goes to a better queued job first. With
+//              no token free, a high priority job takes one from the
+//              latest running low priority job, which is stopped
+//              While pressure is over a --pressure limit, or the
+//              --spawn-rate bucket is empty, every new job is queued
+// --------------------------------------------------------------- //
+int sched_admit(char* args[], struct command* group, struct shell_info *info) {
+  int kind = pressure_over();
+  int token = JOBSERVER_BUSY;
+
+  if (kind == -1 && ratelimit_ready()) {
+    while ((token = jobserver_try()) >= 0) {
+      int best = best_queued();
+
+      if (best == -1 || queue[best].info.priority >= info->priority) {
+        ratelimit_take();
+        return token;
+      }
+
+      start_queued(best, token);  // Was waiting for this, and outranks us
+
+      if (!ratelimit_ready())
+        break;
+    }
+
+    if (token == JOBSERVER_NONE) {
+      while (queue_len && ratelimit_ready())  // Held back before us, they go first
+        start_queued(best_queued(), token);
+
+      if (ratelimit_ready()) {
+        ratelimit_take();
+        return token;
+      }
+
+    } else if (token == JOBSERVER_BUSY && info->priority == PRIO_HIGH) {
+      pid_t victim = jobserver_take_from(PRIO_LOW, &token);
+
+      if (victim) {
+        kill(-victim, SIGSTOP);  // Its whole group, children of a make or sh too
+
+        if (stopped_len == stopped_cap) {
+          stopped_cap = stopped_cap ? stopped_cap * 2 : 16;
+          stopped = realloc(stopped, stopped_cap * sizeof(pid_t));
+        }
+        stopped[stopped_len++] = victim;
+        stat_preempted++;
+
+        ratelimit_take();
+        return token;
+      }
+    }
+  }
+
+  enqueue(args, group, info);
+
+  if (kind != -1) {
+    pressure_deferred(kind);
+    printf("background job queued, %s pressure %.2f%% \n", pressure_name(kind), pressure_value(kind));
+  } else if (!ratelimit_ready()) {
+    ratelimit_deferred();
+    printf("background job queued, spawn rate limit \n");
+  } else {
+    printf("background job queued \n");
+  }
+  fflush(stdout);
+
+  return SCHED_QUEUED;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_free(..)
+// parameters : int token
+// description: Hands on the token of a job that finished: to the best
+//              queued job unless it is low priority, then to a stopped
+//              low job, then to any queued job, else back to the
+//              jobserver. Queued jobs are passed over while pressure
+//              or the spawn rate holds them back
+// --------------------------------------------------------------- //
+void sched_free(int token) {
+  if (token < 0)
+    return;
+
+  int best = can_start() ? best_queued() : -1;
+
+  if (best != -1 && queue[best].info.priority < PRIO_LOW)
+    start_queued(best, token);
+  else if (stopped_len)
+    resume_stopped(token);
+  else if (best != -1)
+    start_queued(best, token);
+  else
+    jobserver_give(token);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_forget(..)
+// parameters : pid_t pid
+// description: Drops a reaped job from the stopped list, if it was
+//              killed while stopped
+// --------------------------------------------------------------- //
+void sched_forget(pid_t pid) {
+  for (int i = 0; i < stopped_len; i++) {
+    if (stopped[i] == pid) {
+      memmove(stopped + i, stopped + i + 1, (stopped_len - i - 1) * sizeof(pid_t));
+      stopped_len--;
+      return;
+    }
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_pending()
+// parameters : none
+// description: Returns the number of jobs queued or stopped
+// --------------------------------------------------------------- //
+int sched_pending() {
+  return queue_len + stopped_len;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_held()
+// parameters : none
+// description: Returns 1 if queued jobs are held back by pressure or
+//              the spawn rate, which no job exiting will let through
+// --------------------------------------------------------------- //
+int sched_held() {
+  return queue_len && !can_start();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_next_ms()
+// parameters : none
+// description: Returns how long, in milliseconds, until queued jobs
+//              held back by pressure or the spawn rate are worth
+//              looking at again, or -1 if none are held back
+// --------------------------------------------------------------- //
+int sched_next_ms() {
+  if (!sched_held())
+    return -1;
+
+  if (pressure_over() != -1)
+    return PRESSURE_POLL_MS;
+
+  return ratelimit_next_ms();
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_pump(..)
+// parameters : int block
+//              void (*reap)()
+// description: Hands tokens that came free in the jobserver to
+//              waiting jobs. With block, waits for at least one
+//              (reap() collects jobs meanwhile), or for as long as
+//              pressure or the spawn rate holds them back. Without a
+//              jobserver, everything waiting is started as soon as
+//              they allow
+// --------------------------------------------------------------- //
+void sched_pump(int block, void (*reap)()) {
+  while (sched_pending()) {
+    if (!stopped_len && sched_held()) {
+      if (block && pressure_over() != -1)
+        pressure_wait(reap);
+      else if (block)
+        ratelimit_wait(reap);
+      break;
+    }
+
+    int token = block ? jobserver_acquire(reap) : jobserver_try();
+
+    if (token == JOBSERVER_BUSY)
+      break;
+
+    if (token == JOBSERVER_NONE) {  // Nothing limits jobs but pressure and rate
+      while (stopped_len)
+        resume_stopped(JOBSERVER_NONE);
+      while (queue_len && can_start())
+        start_queued(best_queued(), JOBSERVER_NONE);
+      break;
+    }
+
+    if (!sched_pending()) {  // reap() already served them
+      jobserver_give(token);
+      break;
+    }
+
+    sched_free(token);
+
+    if (block)
+      break;
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : drop_queued(..)
+// parameters : int kind
+// description: Forgets every queued job, reporting how many and the
+//              pressure that held them back
+// --------------------------------------------------------------- //
+static void drop_queued(int kind) {
+  fprintf(stderr, "smallsh: %d queued job%s dropped, %s pressure %.2f%%\n", queue_len,
+          queue_len == 1 ? "" : "s", pressure_name(kind), pressure_value(kind));
+
+  while (queue_len) {
+    struct pending* job = &queue[--queue_len];
+
+    forget_job(job);
+    release_cwd(job->cwd);
+  }
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_finish(..)
+// parameters : void (*reap)()
+// description: When the shell ends, starts every queued job as tokens
+//              free up, and continues stopped ones, so none is lost
+//              Pressure may not come down while the shell waits: after
+//              PRESSURE_FINISH_MS of it holding back the queue with no
+//              job started, the rest are dropped and the shell exits
+// --------------------------------------------------------------- //
+void sched_finish(void (*reap)()) {
+  long long held_since = 0;
+  int left = queue_len;
+  int kind;
+
+  while (queue_len) {
+    if (queue_len < left || (kind = pressure_over()) == -1) {
+      held_since = 0;  // Getting somewhere
+      left = queue_len;
+    } else if (!held_since) {
+      held_since = now_ns();
+    } else if (now_ns() - held_since > PRESSURE_FINISH_MS * 1000000LL) {
+      drop_queued(kind);
+      break;
+    }
+
+    sched_pump(1, reap);
+  }
+
+  for (int i = 0; i < stopped_len; i++)
+    kill(-stopped[i], SIGCONT);
+  stopped_len = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_detach()
+// parameters : none
+// description: In a forked copy of the shell, forgets the parent's
+//              queued and stopped jobs
+// --------------------------------------------------------------- //
+void sched_detach() {
+  queue_len = 0;
+  last_place = NULL;
+  stopped_len = 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : sched_print_stats()
+// parameters : none
+// description: Prints the scheduling counters (stats), nothing if no
+//              job ever had to wait
+// --------------------------------------------------------------- //
+void sched_print_stats() {
+  if (!stat_queued && !stat_preempted)
+    return;
+
+  unsigned long started = stat_queued - queue_len;
+
+  printf("sched: %lu queued, %d waiting, %lu preempted, %lu resumed, "
+         "%.1f ms queued on average (max %.1f ms)\n",
+         stat_queued, queue_len, stat_preempted, stat_resumed,
+         started ? stat_queued_ns / 1e6 / started : 0, stat_queued_max_ns / 1e6);
+  fflush(stdout);
+}
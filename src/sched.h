@@ -0,0 +1,50 @@
+// sched.h
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <sys/types.h>
+#include "src/shell_info.h"
+#include "src/command.h"
+
+
+// --------------------------------------------------------------- //
+// description: Priorities for commands started with -p high|normal|low
+//              Low priority runs at nice 19, SCHED_IDLE and idle I/O
+//              When & jobs are limited by a jobserver, a job with no
+//              token is queued instead of blocking the shell, queued
+//              jobs start highest priority first, and a high priority
+//              job may stop a running low one's process group
+//              (SIGSTOP) and take its token until a token is free for
+//              it again (SIGCONT). Every & job has a group of its own
+//              A queued job may start during any later command; it
+//              keeps the cwd and environment it was queued in
+//              Jobs are also queued while PSI pressure is over a
+//              --pressure limit (pressure.h), or while the --spawn-rate
+//              bucket is empty (ratelimit.h)
+// --------------------------------------------------------------- //
+#define PRIO_HIGH    0
+#define PRIO_NORMAL  1
+#define PRIO_LOW     2
+
+#define SCHED_QUEUED -3  // sched_admit(): the job waits in the queue
+
+// Starts a job, command args or a group, with the token it was given,
+// see spawn_cmd and fork_group
+typedef void (*sched_launch_fn)(char* args[], struct command* group, struct shell_info *info, int token);
+
+int  sched_level(const char* name);
+void sched_apply(int prio);
+void sched_init(sched_launch_fn launch);
+int  sched_admit(char* args[], struct command* group, struct shell_info *info);
+void sched_free(int token);
+void sched_forget(pid_t pid);
+int  sched_pending();
+int  sched_held();
+int  sched_next_ms();
+void sched_pump(int block, void (*reap)());
+void sched_finish(void (*reap)());
+void sched_detach();
+void sched_print_stats();
+
+#endif
@@ -1,18 +1,24 @@
-// shell_info.c
-
-#include <string.h>
-#include "src/shell_info.h"
-
-
-// --------------------------------------------------------------- //
-// function   : init_shell_info(..)
-// parameters : struct shell_info *info
-// description: Initialized the values of shell_info to 0 or empty
-// --------------------------------------------------------------- //
-void init_shell_info(struct shell_info *info) {
-  info->background = 0;
-  info->input_redirect = 0;
-  info->output_redirect = 0;
-  memset(info->input_filename, 0, sizeof(info->input_filename));
-  memset(info->output_filename, 0, sizeof(info->output_filename));
-}
+// shell_info.c
+
+#include <string.h>
+#include "src/shell_info.h"
+#include "src/sched.h"
+
+
+// --------------------------------------------------------------- //
+// function   : init_shell_info(..)
+// parameters : struct shell_info *info
+// description: Initialized the values of shell_info to 0 or empty
+// --------------------------------------------------------------- //
+void init_shell_info(struct shell_info *info) {
+  info->background = 0;
+  info->input_redirect = 0;
+  info->output_redirect = 0;
+  info->output_append = 0;
+  info->output_fd = -1;
+  info->input_fd = -1;
+  info->priority = PRIO_NORMAL;
+  info->journal_index = 0;
+  memset(info->input_filename, 0, sizeof(info->input_filename));
+  memset(info->output_filename, 0, sizeof(info->output_filename));
+}
@@ -0,0 +1,32 @@
+// smallsh_plugin.h
+
+#ifndef SMALLSH_PLUGIN_H
+#define SMALLSH_PLUGIN_H
+
+
+// --------------------------------------------------------------- //
+// description: ABI for builtins loaded from shared objects, either at
+//              startup from SMALLSH_PLUGINS (colon separated paths) or
+//              with 'enable -f file.so'. The shared object exports
+//
+//                int smallsh_plugin_init(struct smallsh_plugin_api *api);
+//
+//              which calls api->register_builtin() for each builtin it
+//              provides and returns 0 on success. Builtins run inside
+//              the shell process: fds holds the descriptors to use for
+//              stdin, stdout and stderr (redirections already applied)
+//              and the return value is the command's exit value
+// --------------------------------------------------------------- //
+
+#define SMALLSH_PLUGIN_ABI 1
+
+typedef int (*smallsh_builtin)(int argc, char* argv[], int fds[3], char* envp[]);
+
+struct smallsh_plugin_api {
+  int abi;  // SMALLSH_PLUGIN_ABI of the running shell
+  int (*register_builtin)(const char* name, smallsh_builtin fn);
+};
+
+typedef int (*smallsh_plugin_init_fn)(struct smallsh_plugin_api *api);
+
+#endif
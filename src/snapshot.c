@@ -0,0 +1,550 @@
+// snapshot.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "src/snapshot.h"
+#include "src/options.h"
+
+#define SNAP_MAGIC "smsnap3"  // Format of the image, with its NUL
+
+#define SNAP_CACHE_MAX   64     // Images kept, least recently used go first
+#define SNAP_TOUCH_AFTER 86400  // Seconds before a hit marks an image used again
+
+// --------------------------------------------------------------- //
+// structure  : struct snap_header
+// description: Start of a compiled image. It is followed by
+//                uint32_t line_start[lines + 1]  first word of each line
+//                uint32_t word_at[words]         offset of each word
+//                char     text[]                 the words, NUL ended
+//              Offsets are from the start of the image, so a mapped
+//              cache file is used without any pointer fixups
+// --------------------------------------------------------------- //
+struct snap_header {
+  char     magic[8];
+  char     version[16];  // SMALLSH_VERSION that compiled it
+  uint64_t hash;         // Of the version and the source's identity
+  uint64_t text_hash;    // Of the source text, checked before any use
+  uint64_t src_size;
+  uint32_t lines;
+  uint32_t words;
+};
+
+
+// --------------------------------------------------------------- //
+// function   : fnv1a(..)
+// parameters : uint64_t h
+//              const char* p
+//              size_t len
+// description: Continues a 64-bit FNV-1a hash over len bytes at p
+// --------------------------------------------------------------- //
+static uint64_t fnv1a(uint64_t h, const char* p, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char) p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : source_key(..)
+// parameters : const struct stat *st
+// description: Returns the hash a source is cached under: the shell
+//              version and the file's device, inode, mtime and size
+//              Editing or replacing the file changes it, and nothing
+//              has to be read to work it out
+// --------------------------------------------------------------- //
+static uint64_t source_key(const struct stat *st) {
+  uint64_t h = fnv1a(14695981039346656037ULL, SMALLSH_VERSION, sizeof(SMALLSH_VERSION));
+  uint64_t fields[] = { st->st_dev, st->st_ino, st->st_mtim.tv_sec, st->st_mtim.tv_nsec, st->st_size };
+
+  return fnv1a(h, (const char*) fields, sizeof(fields));
+}
+
+
+// --------------------------------------------------------------- //
+// function   : cache_file(..)
+// parameters : uint64_t hash
+//              char* buf
+//              size_t len
+//              int create
+// description: Puts the cache path for a source with this hash into
+//              buf: $XDG_CACHE_HOME/smallsh/<hash>.snap, falling back
+//              to ~/.cache. With create, makes the directory
+//              Returns 0, or -1 if there is nowhere to cache
+// --------------------------------------------------------------- //
+static int cache_file(uint64_t hash, char* buf, size_t len, int create) {
+  const char* xdg = getenv("XDG_CACHE_HOME");
+  const char* home = getenv("HOME");
+  int n;
+
+  if (xdg && xdg[0] == '/')
+    n = snprintf(buf, len, "%s/smallsh", xdg);
+  else if (home && home[0])
+    n = snprintf(buf, len, "%s/.cache/smallsh", home);
+  else
+    return -1;
+
+  if (n < 0 || (size_t) n + 22 >= len)
+    return -1;
+
+  if (create) {
+    char* slash = strrchr(buf, '/');
+
+    *slash = '\0';
+    mkdir(buf, 0700);  // ~/.cache may not exist yet
+    *slash = '/';
+
+    if (mkdir(buf, 0700) == -1 && errno != EEXIST)
+      return -1;
+  }
+
+  snprintf(buf + n, len - n, "/%016llx.snap", (unsigned long long) hash);
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : read_source(..)
+// parameters : int fd
+//              const struct stat *st
+//              size_t* len
+// description: Reads a whole file, NUL terminated
+//              Returns the malloc'd text, or NULL if it can't be read
+// --------------------------------------------------------------- //
+static char* read_source(int fd, const struct stat *st, size_t* len) {
+  size_t cap, used = 0;
+  char* text;
+  ssize_t n;
+
+  cap = st->st_size > 0 ? st->st_size + 1 : 4096;
+  text = malloc(cap);
+
+  while ((n = read(fd, text + used, cap - used - 1)) > 0) {
+    used += n;
+    if (used + 1 == cap)  // Grew since fstat
+      text = realloc(text, cap *= 2);
+  }
+
+  if (n == -1) {
+    free(text);
+    return NULL;
+  }
+
+  text[used] = '\0';
+  *len = used;
+  return text;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : next_line(..)
+// parameters : const char** p
+//              const char* end
+//              const char** start
+//              const char** stop
+// description: Steps *p past one line of the source, the way getline
+//              reads it. The line's text runs from start to stop,
+//              newline excluded. Returns 0 when no lines are left
+// --------------------------------------------------------------- //
+static int next_line(const char** p, const char* end, const char** start, const char** stop) {
+  if (*p >= end)
+    return 0;
+
+  const char* nl = memchr(*p, '\n', end - *p);
+
+  *start = *p;
+  *stop = nl ? nl : end;
+  *p = nl ? nl + 1 : end;
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : compile(..)
+// parameters : const char* text
+//              size_t len
+//              uint64_t hash
+//              uint64_t text_hash
+//              size_t* size
+// description: Builds the image of a source. Lines are split exactly
+//              as the shell splits typed input: on " ", with a line
+//              holding only a newline kept as the word "\n" (a blank
+//              command). Returns the malloc'd image
+// --------------------------------------------------------------- //
+static char* compile(const char* text, size_t len, uint64_t hash, uint64_t text_hash, size_t* size) {
+  const char* end = text + len;
+  const char *p, *s, *e;
+  uint32_t lines = 0, words = 0;
+  size_t bytes = 0;
+
+  for (p = text; next_line(&p, end, &s, &e); lines++) {  // Size it up first
+    if (s == e && e < end) {  // Only a newline
+      words++;
+      bytes += 2;
+      continue;
+    }
+
+    for (const char* c = s; c < e; c++)
+      if (*c != ' ' && (c == s || c[-1] == ' '))
+        words++;
+    bytes += (e - s) + 1;
+  }
+
+  size_t words_at = sizeof(struct snap_header) + (lines + 1) * sizeof(uint32_t);
+  size_t text_at = words_at + words * sizeof(uint32_t);
+
+  *size = text_at + bytes + 1;
+  char* image = calloc(1, *size);
+
+  struct snap_header* h = (struct snap_header*) image;
+  uint32_t* line_start = (uint32_t*) (image + sizeof(*h));
+  uint32_t* word_at = (uint32_t*) (image + words_at);
+  char* out = image + text_at;
+  uint32_t line = 0, word = 0;
+
+  memcpy(h->magic, SNAP_MAGIC, sizeof(SNAP_MAGIC));
+  snprintf(h->version, sizeof(h->version), "%s", SMALLSH_VERSION);
+  h->hash = hash;
+  h->text_hash = text_hash;
+  h->src_size = len;
+  h->lines = lines;
+  h->words = words;
+
+  for (p = text; next_line(&p, end, &s, &e); ) {
+    line_start[line++] = word;
+
+    if (s == e && e < end) {
+      word_at[word++] = out - image;
+      *out++ = '\n';
+      *out++ = '\0';
+      continue;
+    }
+
+    char* copy = out;
+    char* saveptr;
+
+    memcpy(copy, s, e - s);
+    copy[e - s] = '\0';
+    out += (e - s) + 1;
+
+    for (char* w = strtok_r(copy, " ", &saveptr); w; w = strtok_r(NULL, " ", &saveptr))
+      word_at[word++] = w - image;
+  }
+  line_start[line] = word;
+
+  return image;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : valid(..)
+// parameters : const char* image
+//              size_t size
+//              uint64_t hash
+//              uint64_t text_hash
+//              size_t len
+// description: Checks a cached image was compiled from this source by
+//              this version, and that every offset stays inside it
+//              Its identity only finds the image: the text it was
+//              compiled from must hash the same and be as long, as an
+//              edit may keep the size and mtime (cp -p, touch -r, a
+//              coarse clock). A damaged cache file is compiled again
+// --------------------------------------------------------------- //
+static int valid(const char* image, size_t size, uint64_t hash, uint64_t text_hash, size_t len) {
+  const struct snap_header* h = (const struct snap_header*) image;
+
+  if (size < sizeof(*h) + sizeof(uint32_t) || image[size - 1] != '\0' ||
+      memcmp(h->magic, SNAP_MAGIC, sizeof(SNAP_MAGIC)) != 0 ||
+      strncmp(h->version, SMALLSH_VERSION, sizeof(h->version)) != 0 || h->hash != hash ||
+      h->text_hash != text_hash || h->src_size != len)
+    return 0;
+
+  size_t words_at = sizeof(*h) + ((size_t) h->lines + 1) * sizeof(uint32_t);
+  size_t text_at = words_at + (size_t) h->words * sizeof(uint32_t);
+
+  if (text_at >= size)
+    return 0;
+
+  const uint32_t* line_start = (const uint32_t*) (image + sizeof(*h));
+  const uint32_t* word_at = (const uint32_t*) (image + words_at);
+
+  for (uint32_t i = 0; i < h->lines; i++)
+    if (line_start[i] > line_start[i + 1])
+      return 0;
+  if (line_start[0] != 0 || line_start[h->lines] != h->words)
+    return 0;
+
+  for (uint32_t i = 0; i < h->words; i++)
+    if (word_at[i] < text_at || word_at[i] >= size)
+      return 0;
+
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : map_cache(..)
+// parameters : struct snapshot *s
+//              const char* path
+//              uint64_t hash
+//              uint64_t text_hash
+//              size_t len
+// description: Maps a cached image for a source with this hash and
+//              text (see valid). Returns 0 if it was there and valid
+// --------------------------------------------------------------- //
+static int map_cache(struct snapshot *s, const char* path, uint64_t hash, uint64_t text_hash, size_t len) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &st) == -1 || st.st_size == 0) {
+    close(fd);
+    return -1;
+  }
+
+  void* image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (image == MAP_FAILED) {
+    close(fd);
+    return -1;
+  }
+
+  if (!valid(image, st.st_size, hash, text_hash, len)) {
+    close(fd);
+    munmap(image, st.st_size);
+    return -1;
+  }
+
+  if (st.st_mtime < time(NULL) - SNAP_TOUCH_AFTER)
+    futimens(fd, NULL);  // Still in use, keep it from eviction
+  close(fd);
+
+  s->image = image;
+  s->size = st.st_size;
+  s->mapped = 1;
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// structure  : struct cached
+// description: An image in the cache directory, for evict()
+// --------------------------------------------------------------- //
+struct cached {
+  char   name[24];  // <hash>.snap
+  time_t used;      // Its mtime
+};
+
+
+// --------------------------------------------------------------- //
+// function   : by_age(..)
+// parameters : const void* a
+//              const void* b
+// description: qsort() order for evict(), least recently used first
+// --------------------------------------------------------------- //
+static int by_age(const void* a, const void* b) {
+  time_t x = ((const struct cached*) a)->used, y = ((const struct cached*) b)->used;
+
+  return (x > y) - (x < y);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : evict(..)
+// parameters : const char* path
+// description: Keeps the cache directory of path to SNAP_CACHE_MAX
+//              images, removing the ones used longest ago (by mtime,
+//              which a hit refreshes now and then). Only run after
+//              writing an image, so runs that hit pay nothing
+// --------------------------------------------------------------- //
+static void evict(const char* path) {
+  char dir[4096];
+  struct cached* found = NULL;
+  int len = 0, cap = 0;
+  struct dirent* e;
+  struct stat st;
+
+  snprintf(dir, sizeof(dir), "%s", path);
+  *strrchr(dir, '/') = '\0';
+
+  DIR* d = opendir(dir);
+
+  if (!d)
+    return;
+
+  while ((e = readdir(d))) {
+    size_t n = strlen(e->d_name);
+
+    if (n != 21 || strcmp(e->d_name + 16, ".snap") != 0 ||
+        fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+      continue;
+
+    if (len == cap) {
+      struct cached* grown = realloc(found, (cap = cap ? cap * 2 : 128) * sizeof(*found));
+
+      if (!grown)
+        break;
+      found = grown;
+    }
+
+    memcpy(found[len].name, e->d_name, n + 1);
+    found[len++].used = st.st_mtime;
+  }
+
+  if (len > SNAP_CACHE_MAX) {
+    qsort(found, len, sizeof(*found), by_age);
+
+    for (int i = 0; i < len - SNAP_CACHE_MAX; i++)
+      unlinkat(dirfd(d), found[i].name, 0);
+  }
+
+  closedir(d);
+  free(found);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : write_cache(..)
+// parameters : const char* path
+//              const char* image
+//              size_t size
+// description: Saves an image for later runs. It is written to a
+//              temporary file and renamed into place, so a shell
+//              reading the cache never sees half of it. Failing to
+//              cache is not an error, the next run compiles again
+// --------------------------------------------------------------- //
+static void write_cache(const char* path, const char* image, size_t size) {
+  char tmp[4096 + 16];
+  int fd;
+
+  snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+  if (fd == -1)
+    return;
+
+  if (write(fd, image, size) != (ssize_t) size || close(fd) == -1 || rename(tmp, path) == -1)
+    unlink(tmp);
+  else
+    evict(path);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : snapshot_open(..)
+// parameters : struct snapshot *s
+//              const char* src
+// description: Loads the compiled form of script src. The cached image
+//              is found by the source's identity (source_key) and used
+//              as is if the source text still hashes the same: reading
+//              and hashing the text is far cheaper than splitting it
+//              If there is none, or it's stale or damaged, the source
+//              is compiled and the result cached, unless the file
+//              changed while it was read. Returns -1 if src can't be
+//              read
+// --------------------------------------------------------------- //
+int snapshot_open(struct snapshot *s, const char* src) {
+  char path[4096];
+  struct stat st, after;
+  size_t len;
+  int fd = open(src, O_RDONLY | O_CLOEXEC);
+
+  memset(s, 0, sizeof(*s));
+
+  if (fd == -1)
+    return -1;
+
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return -1;
+  }
+
+  uint64_t hash = source_key(&st);
+  int cacheable = (cache_file(hash, path, sizeof(path), 0) == 0);
+  char* text = read_source(fd, &st, &len);
+
+  if (!text || fstat(fd, &after) == -1) {
+    close(fd);
+    free(text);
+    return -1;
+  }
+  close(fd);
+
+  uint64_t text_hash = fnv1a(14695981039346656037ULL, text, len);
+
+  if (cacheable && map_cache(s, path, hash, text_hash, len) == 0) {
+    free(text);
+    s->cached = 1;
+    s->lines = ((struct snap_header*) s->image)->lines;
+    return 0;
+  }
+
+  s->image = compile(text, len, hash, text_hash, &s->size);
+  free(text);
+
+  if (source_key(&after) != hash || (off_t) len != st.st_size)
+    cacheable = 0;  // Written to meanwhile, the key may not match the text
+
+  if (cacheable && cache_file(hash, path, sizeof(path), 1) == 0)
+    write_cache(path, s->image, s->size);
+
+  s->lines = ((struct snap_header*) s->image)->lines;
+  return 0;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : snapshot_next(..)
+// parameters : struct snapshot *s
+// description: Returns the next line (caller frees it), or NULL at
+//              the end. Its words point into the image, so only the
+//              word array is allocated. They stay valid until
+//              snapshot_close()
+// --------------------------------------------------------------- //
+struct cmd_desc* snapshot_next(struct snapshot *s) {
+  if (!s->image || s->next >= s->lines)
+    return NULL;
+
+  struct snap_header* h = (struct snap_header*) s->image;
+  uint32_t* line_start = (uint32_t*) (s->image + sizeof(*h));
+  uint32_t* word_at = line_start + h->lines + 1;
+  uint32_t first = line_start[s->next];
+  uint32_t n = line_start[s->next + 1] - first;
+
+  struct cmd_desc* d = malloc(sizeof(*d) + (n + 1) * sizeof(char*));
+
+  d->len = n;
+  for (uint32_t i = 0; i < n; i++)
+    d->tokens[i] = s->image + word_at[first + i];
+  d->tokens[n] = NULL;
+
+  s->next++;
+  return d;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : snapshot_close(..)
+// parameters : struct snapshot *s
+// description: Releases the image. Lines handed out become invalid
+// --------------------------------------------------------------- //
+void snapshot_close(struct snapshot *s) {
+  if (s->mapped)
+    munmap(s->image, s->size);
+  else
+    free(s->image);
+
+  s->image = NULL;
+}
@@ -0,0 +1,30 @@
+// snapshot.h
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "src/reader.h"
+
+
+// --------------------------------------------------------------- //
+// structure  : struct snapshot
+// description: A script compiled to its lines already split into
+//              words. The image is laid out so a cached copy can be
+//              mmapped and its words used in place, see snapshot.c
+// --------------------------------------------------------------- //
+struct snapshot {
+  char*    image;   // Mapped cache file, or compiled in memory
+  size_t   size;
+  int      mapped;  // image is a mapping, not malloc'd
+  int      cached;  // Loaded from the cache, source not parsed
+  uint32_t lines;
+  uint32_t next;    // Next line to hand out
+};
+
+int  snapshot_open(struct snapshot *s, const char* src);
+struct cmd_desc* snapshot_next(struct snapshot *s);
+void snapshot_close(struct snapshot *s);
+
+#endif
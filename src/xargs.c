@@ -0,0 +1,336 @@
+// xargs.c
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "src/xargs.h"
+#include "src/arena.h"
+#include "src/arg_max.h"
+#include "src/arg_vec.h"
+#include "src/exec_cache.h"
+#include "src/fds.h"
+#include "src/reaper.h"
+
+#define XARGS_READ  (64 * 1024)  // Bytes per read() of the input
+#define XARGS_MAX_P 1024         // Cap on -P
+
+// --------------------------------------------------------------- //
+// structure  : struct xargs
+// description: State of one xargs run
+// --------------------------------------------------------------- //
+struct xargs {
+  struct exec_target target;  // The command's binary
+  struct arena   arena;     // Words of the batch being built
+  struct arg_vec batch;     // Command, initial args, then words
+  int    fixed;             // Entries of batch repeated every time
+  long   fixed_size;
+  long   size;              // Exec size of batch so far
+  long   limit;             // Exec size allowed
+  int    max_args;          // -n, 0 for no limit
+  int    max_procs;         // -P
+  int    out_fd;            // stdout for the commands
+  pid_t  pids[XARGS_MAX_P]; // Batches still running
+  int    pidfds[XARGS_MAX_P];  // Their pidfds, -1 if unavailable
+  int    running;
+  int    failed;            // Exit status of xargs so far
+};
+
+
+// --------------------------------------------------------------- //
+// function   : reap_one(..)
+// parameters : struct xargs *x
+// description: Blocks until one running batch exits and records its
+//              status. Waits on pidfds with poll(), so it sleeps until
+//              one of our children is done without ever collecting
+//              the shell's background jobs. A batch without a pidfd
+//              (kernel before 5.3) is waited for directly instead, and
+//              so is the first one if poll() fails
+// --------------------------------------------------------------- //
+static void reap_one(struct xargs *x) {
+  struct pollfd pfds[XARGS_MAX_P];
+  int done = -1;
+  int status;
+
+  for (int i = 0; i < x->running; i++) {
+    if (x->pidfds[i] == -1) {
+      done = i;
+      break;
+    }
+    pfds[i].fd = x->pidfds[i];
+    pfds[i].events = POLLIN;
+  }
+
+  if (done == -1) {
+    int ready;
+
+    while ((ready = poll(pfds, x->running, -1)) == -1 && errno == EINTR)
+      ;  // ^Z, just poll again
+
+    done = 0;
+
+    if (ready == -1)
+      perror("xargs: poll");  // Wait for the first batch directly instead
+    else
+      while (!(pfds[done].revents & (POLLIN | POLLHUP | POLLERR)))
+        done++;
+  }
+
+  while (reaper_wait(x->pids[done], &status, 0) == -1) {
+    if (errno != EINTR) {  // Reaped elsewhere, nothing left to wait for
+      status = 0;
+      break;
+    }
+  }
+
+  if (x->pidfds[done] != -1)
+    close(x->pidfds[done]);
+
+  if (WIFSIGNALED(status))
+    x->failed = 125;
+  else if (WEXITSTATUS(status) == 127 || WEXITSTATUS(status) == 126)
+    x->failed = WEXITSTATUS(status);
+  else if (WEXITSTATUS(status) != 0 && !x->failed)
+    x->failed = 123;
+
+  x->running--;
+  x->pids[done] = x->pids[x->running];
+  x->pidfds[done] = x->pidfds[x->running];
+}
+
+
+// --------------------------------------------------------------- //
+// function   : next_batch(..)
+// parameters : struct xargs *x
+// description: Empties the batch down to the command and its initial
+//              arguments and releases the words
+// --------------------------------------------------------------- //
+static void next_batch(struct xargs *x) {
+  arena_reset(&x->arena);
+  x->batch.len = x->fixed;
+  x->batch.items[x->fixed] = NULL;
+  x->size = x->fixed_size;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : launch(..)
+// parameters : struct xargs *x
+// description: Runs the current batch once a slot is free, then
+//              starts a new batch. The child has its own copy of the
+//              words, so the arena is reused right away. Like GNU
+//              xargs, nothing more is run once a batch was killed or
+//              the command could not be run
+// --------------------------------------------------------------- //
+static void launch(struct xargs *x) {
+  while (x->running >= x->max_procs)
+    reap_one(x);
+
+  if (x->failed >= 125) {
+    next_batch(x);
+    return;
+  }
+
+  fflush(stdout);
+  pid_t pid = reaper_fork();
+
+  if (pid == 0) {
+    struct sigaction SIG_H = { 0 };  // Foreground child: default ^C, ignore ^Z
+    SIG_H.sa_handler = SIG_DFL;
+    sigaction(SIGINT, &SIG_H, NULL);
+    SIG_H.sa_handler = SIG_IGN;
+    sigaction(SIGTSTP, &SIG_H, NULL);
+
+    int null = open("/dev/null", O_RDONLY);  // The input belongs to xargs
+    if (null != -1)
+      dup2(null, 0);
+    if (x->out_fd != 1)
+      dup2(x->out_fd, 1);
+
+    exec_run(&x->target, x->batch.items);
+    perror("execvp");
+    _exit(127);
+  }
+
+  if (pid == -1) {
+    perror("fork() \n");
+    x->failed = 125;
+  } else {
+    x->pids[x->running] = pid;
+    x->pidfds[x->running] = syscall(SYS_pidfd_open, pid, 0);
+    x->running++;
+  }
+
+  next_batch(x);
+}
+
+
+// --------------------------------------------------------------- //
+// function   : add_word(..)
+// parameters : struct xargs *x
+//              char* word
+//              size_t len
+// description: Adds a word to the batch, launching the batch first
+//              if the word would take it past the exec or -n limit
+// --------------------------------------------------------------- //
+static void add_word(struct xargs *x, char* word, size_t len) {
+  long size = len + 1 + sizeof(char*);
+  int words = x->batch.len - x->fixed;
+
+  if (words && (x->size + size > x->limit || (x->max_args && words >= x->max_args)))
+    launch(x);
+
+  char* copy = arena_alloc(&x->arena, len + 1);
+  memcpy(copy, word, len);
+  copy[len] = '\0';
+
+  arg_vec_push(&x->batch, copy);
+  x->size += size;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : usage(..)
+// description: Prints xargs usage, returns the exit status for it
+// --------------------------------------------------------------- //
+static int usage() {
+  printf("usage: xargs [-0] [-n max-args] [-P max-procs] command [args] \n");
+  fflush(stdout);
+  return 1;
+}
+
+
+// --------------------------------------------------------------- //
+// function   : my_xargs(..)
+// parameters : char* args[]
+//              struct shell_info *info
+// description: Runs the xargs builtin. Input is read in large blocks
+//              and split on the delimiter; a word spanning two reads
+//              is carried over to the next. Returns the exit value:
+//              0, 123 if any batch failed, 125 if one was killed,
+//              126/127 if the command could not be run
+// example    : find . -name *.o -print0 > list ; xargs -0 -P 4 rm < list
+// --------------------------------------------------------------- //
+int my_xargs(char* args[], struct shell_info *info) {
+  struct xargs x;
+  char delim = '\n';
+  int a = 1;
+
+  memset(&x, 0, sizeof(x));
+  x.max_procs = 1;
+
+  for (; args[a] && args[a][0] == '-'; a++) {  // Options
+    if (strcmp(args[a], "-0") == 0) {
+      delim = '\0';
+    } else if (strcmp(args[a], "-n") == 0 && args[a + 1]) {
+      x.max_args = atoi(args[++a]);
+    } else if (strcmp(args[a], "-P") == 0 && args[a + 1]) {
+      x.max_procs = atoi(args[++a]);
+      if (x.max_procs <= 0)  // As many as there are CPUs
+        x.max_procs = sysconf(_SC_NPROCESSORS_ONLN);
+    } else {
+      return usage();
+    }
+  }
+
+  if (!args[a])
+    return usage();
+  if (x.max_procs > XARGS_MAX_P)
+    x.max_procs = XARGS_MAX_P;
+
+  int io[2];
+  if (fds_open_io(info, io) == -1)
+    return 1;
+
+  int in_fd = io[0] != -1 ? io[0] : 0;
+  x.out_fd = io[1] != -1 ? io[1] : 1;
+
+  arena_init(&x.arena);
+  arg_vec_init(&x.batch, NULL);
+  x.fixed_size = sizeof(char*);
+  for (; args[a]; a++) {
+    arg_vec_push(&x.batch, args[a]);
+    x.fixed_size += exec_arg_size(args[a]);
+  }
+  x.fixed = x.batch.len;
+  exec_lookup(x.batch.items[0], &x.target);
+  x.size = x.fixed_size;
+  x.limit = exec_arg_limit();
+
+  char* buf = malloc(XARGS_READ);
+  char* word = NULL;  // Part of a word left over from the last read
+  size_t word_len = 0;
+  size_t word_cap = 0;
+  ssize_t n;
+
+  // Like GNU xargs, give up once a batch is killed or can't be run
+  while (x.failed < 125 && (n = read(in_fd, buf, XARGS_READ)) != 0) {
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+
+      perror("xargs");  // EISDIR, EIO: not something to retry
+      x.failed = 1;
+      word_len = 0;  // Half a word, don't run it
+      break;
+    }
+
+    char* start = buf;
+    char* end = buf + n;
+    char* d;
+
+    while ((d = memchr(start, delim, end - start))) {
+      if (word_len) {  // Finish the carried over word
+        if (word_len + (d - start) > word_cap) {
+          word_cap = (word_len + (d - start)) * 2;
+          word = realloc(word, word_cap);
+        }
+        memcpy(word + word_len, start, d - start);
+        add_word(&x, word, word_len + (d - start));
+        word_len = 0;
+
+      } else if (d > start || delim == '\0') {  // Blank lines are skipped
+        add_word(&x, start, d - start);
+      }
+
+      start = d + 1;
+    }
+
+    if (start < end) {  // Carry the partial word to the next read
+      if (word_len + (end - start) > word_cap) {
+        word_cap = (word_len + (end - start)) * 2;
+        word = realloc(word, word_cap);
+      }
+      memcpy(word + word_len, start, end - start);
+      word_len += end - start;
+    }
+  }
+
+  if (word_len && x.failed < 125)  // Last word had no delimiter
+    add_word(&x, word, word_len);
+
+  if (x.batch.len > x.fixed && x.failed < 125)
+    launch(&x);
+
+  while (x.running)
+    reap_one(&x);
+
+  free(buf);
+  free(word);
+  free(x.batch.items);  // Items are borrowed, free just the array
+  arena_free(&x.arena);
+
+  if (in_fd != 0)
+    close(in_fd);
+  if (x.out_fd != 1)
+    close(x.out_fd);
+
+  return x.failed;
+}
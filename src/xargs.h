@@ -0,0 +1,17 @@
+// xargs.h
+
+#ifndef XARGS_H
+#define XARGS_H
+
+#include "src/shell_info.h"
+
+
+// --------------------------------------------------------------- //
+// description: In-process xargs. Reads newline (or with -0, NUL)
+//              delimited words from stdin or the < file and runs the
+//              command on as many as one exec can take, with up to
+//              -P batches running at once
+// --------------------------------------------------------------- //
+int my_xargs(char* args[], struct shell_info *info);
+
+#endif